@@ -33,8 +33,45 @@
 #include "gpio.h"
 #include "osapi.h"
 #include "ets_sys.h"
-
-#define EASYGPIO_USE_GPIO_INPUT_GET
+#include "easygpio/easygpio_log.h"
+
+#define EASYGPIO_INTERRUPT_PINS 16 // GPIO0-15, GPIO16 has no interrupt
+#define EASYGPIO_GPIO_PIN_MASK 0xffff // the pins handled by the GPIO registers, GPIO16 is an RTC pin
+
+// The functions that easygpio.h wraps in macros are defined with their names in parentheses,
+// so that the macros don't expand here.
+
+typedef struct {
+  uint8_t muxOffset; // the pin mux register, relative to PERIPHS_IO_MUX. 0 if there is no such GPIO
+  uint8_t func;
+} EasyGPIO_PinMux;
+
+#define EASYGPIO_PIN_MUX(gpio_name, gpio_func) { (gpio_name) - PERIPHS_IO_MUX, (gpio_func) }
+
+// The pin mux register and function of GPIO0-15, GPIO16 is configured through the RTC registers
+static const EasyGPIO_PinMux easygpio_pinMux[EASYGPIO_INTERRUPT_PINS] = {
+  [0] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_GPIO0_U, FUNC_GPIO0),
+  [1] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_U0TXD_U, FUNC_GPIO1),
+  [2] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_GPIO2_U, FUNC_GPIO2),
+  [3] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_U0RXD_U, FUNC_GPIO3),
+  [4] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_GPIO4_U, FUNC_GPIO4),
+  [5] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_GPIO5_U, FUNC_GPIO5),
+  [9] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_SD_DATA2_U, FUNC_GPIO9),
+  [10] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_SD_DATA3_U, FUNC_GPIO10),
+  [12] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12),
+  [13] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13),
+  [14] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_MTMS_U, FUNC_GPIO14),
+  [15] = EASYGPIO_PIN_MUX(PERIPHS_IO_MUX_MTDO_U, FUNC_GPIO15),
+};
+
+typedef struct {
+  void (*handler)(void *arg);
+  void *arg;
+} EasyGPIO_Interrupt;
+
+// The handler of every pin, called by easygpio_intrHandler()
+static EasyGPIO_Interrupt easygpio_interrupts[EASYGPIO_INTERRUPT_PINS];
+static volatile uint32_t easygpio_attachedPins = 0; // a mask containing the pins with a handler
 
 static void ICACHE_FLASH_ATTR
 gpio16_output_conf(void) {
@@ -65,13 +102,7 @@ gpio16_input_conf(void) {
  */
 uint8_t ICACHE_FLASH_ATTR
 easygpio_countBits(uint32_t gpioMask) {
-
-  uint8_t i=0;
-  uint8_t numberOfPins=0;
-  for (i=0; i<32; i++){
-    numberOfPins += (gpioMask & BIT(i))?1:0;
-  }
-  return numberOfPins;
+  return __builtin_popcount(gpioMask);
 }
 
 /**
@@ -80,66 +111,16 @@ easygpio_countBits(uint32_t gpioMask) {
 bool ICACHE_FLASH_ATTR
 easygpio_getGPIONameFunc(uint8_t gpio_pin, uint32_t *gpio_name, uint8_t *gpio_func) {
 
-  if (gpio_pin == 6 || gpio_pin == 7 || gpio_pin == 8 || gpio_pin == 11 || gpio_pin >= 17) {
-    os_printf("easygpio_getGPIONameFunc Error: There is no GPIO%d, check your code\n", gpio_pin);
-    return false;
-  }
   if (gpio_pin == 16) {
-    os_printf("easygpio_getGPIONameFunc Error: GPIO16 does not have gpio_name and gpio_func\n");
+    EASYGPIO_LOG_ERROR("easygpio_getGPIONameFunc Error: GPIO16 does not have gpio_name and gpio_func\n");
     return false;
   }
-  switch ( gpio_pin ) {
-    case 0:
-      *gpio_func = FUNC_GPIO0;
-      *gpio_name = PERIPHS_IO_MUX_GPIO0_U;
-      return true;
-    case 1:
-      *gpio_func = FUNC_GPIO1;
-      *gpio_name = PERIPHS_IO_MUX_U0TXD_U;
-      return true;
-    case 2:
-      *gpio_func = FUNC_GPIO2;
-      *gpio_name = PERIPHS_IO_MUX_GPIO2_U;
-      return true;
-    case 3:
-      *gpio_func = FUNC_GPIO3;
-      *gpio_name = PERIPHS_IO_MUX_U0RXD_U;
-      return true;
-    case 4:
-      *gpio_func = FUNC_GPIO4;
-      *gpio_name = PERIPHS_IO_MUX_GPIO4_U;
-      return true;
-    case 5:
-      *gpio_func = FUNC_GPIO5;
-      *gpio_name = PERIPHS_IO_MUX_GPIO5_U;
-      return true;
-    case 9:
-      *gpio_func = FUNC_GPIO9;
-      *gpio_name = PERIPHS_IO_MUX_SD_DATA2_U;
-      return true;
-    case 10:
-      *gpio_func = FUNC_GPIO10;
-      *gpio_name = PERIPHS_IO_MUX_SD_DATA3_U;
-      return true;
-    case 12:
-      *gpio_func = FUNC_GPIO12;
-      *gpio_name = PERIPHS_IO_MUX_MTDI_U;
-      return true;
-    case 13:
-      *gpio_func = FUNC_GPIO13;
-      *gpio_name = PERIPHS_IO_MUX_MTCK_U;
-      return true;
-    case 14:
-      *gpio_func = FUNC_GPIO14;
-      *gpio_name = PERIPHS_IO_MUX_MTMS_U;
-      return true;
-    case 15:
-      *gpio_func = FUNC_GPIO15;
-      *gpio_name = PERIPHS_IO_MUX_MTDO_U;
-      return true;
-    default:
-      return false;
+  if (gpio_pin > 16 || !easygpio_pinMux[gpio_pin].muxOffset) {
+    EASYGPIO_LOG_ERROR("easygpio_getGPIONameFunc Error: There is no GPIO%d, check your code\n", gpio_pin);
+    return false;
   }
+  *gpio_name = PERIPHS_IO_MUX + easygpio_pinMux[gpio_pin].muxOffset;
+  *gpio_func = easygpio_pinMux[gpio_pin].func;
   return true;
 }
 
@@ -160,7 +141,7 @@ easygpio_setupPullsByName(uint32_t gpio_name, EasyGPIO_PullStatus pullStatus) {
  * Sets the pull registers for a pin.
  */
 bool ICACHE_FLASH_ATTR
-easygpio_pullMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus) {
+(easygpio_pullMode)(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus) {
   uint32_t gpio_name;
   uint8_t gpio_func;
 
@@ -177,7 +158,7 @@ easygpio_pullMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus) {
  * 'pullStatus' has no effect on output pins or GPIO16
  */
 bool ICACHE_FLASH_ATTR
-easygpio_pinMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, EasyGPIO_PinMode pinMode) {
+(easygpio_pinMode)(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, EasyGPIO_PinMode pinMode) {
   uint32_t gpio_name;
   uint8_t gpio_func;
 
@@ -205,25 +186,44 @@ easygpio_pinMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, EasyGPIO_PinM
   return true;
 }
 
+/**
+ * The one GPIO interrupt handler, shared by every pin. Clears the status of every pin that
+ * fired in one write, then calls the handler of each of those pins, lowest pin first.
+ * The cost is proportional to the number of pins that fired, not to the number of attached pins.
+ */
+static void
+easygpio_intrHandler(void *arg) {
+  uint32_t status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
+  uint32_t pending = status & easygpio_attachedPins;
+  uint8_t pin = 0;
+
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, status);
+  while (pending) {
+    pin = __builtin_ctz(pending);
+    pending &= pending - 1; // clear the lowest set bit
+    easygpio_interrupts[pin].handler(easygpio_interrupts[pin].arg);
+  }
+}
+
 /**
  * Sets the 'gpio_pin' pin as a GPIO and sets the interrupt to trigger on that pin.
  * The 'interruptArg' is the function argument that will be sent to your interruptHandler
  */
 bool ICACHE_FLASH_ATTR
-easygpio_attachInterrupt(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, void (*interruptHandler)(void *arg), void *interruptArg) {
+(easygpio_attachInterrupt)(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, void (*interruptHandler)(void *arg), void *interruptArg) {
   uint32_t gpio_name;
   uint8_t gpio_func;
 
   if (gpio_pin == 16) {
-    os_printf("easygpio_setupInterrupt Error: GPIO16 does not have interrupts\n");
+    EASYGPIO_LOG_ERROR("easygpio_setupInterrupt Error: GPIO16 does not have interrupts\n");
     return false;
   }
   if (!easygpio_getGPIONameFunc(gpio_pin, &gpio_name, &gpio_func) ) {
     return false;
   }
 
-  ETS_GPIO_INTR_ATTACH(interruptHandler, interruptArg);
   ETS_GPIO_INTR_DISABLE();
+  ETS_GPIO_INTR_ATTACH(easygpio_intrHandler, NULL);
 
   PIN_FUNC_SELECT(gpio_name, gpio_func);
 
@@ -236,7 +236,11 @@ easygpio_attachInterrupt(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, void
                     | GPIO_PIN_PAD_DRIVER_SET(GPIO_PAD_DRIVER_DISABLE)
                     | GPIO_PIN_SOURCE_SET(GPIO_AS_PIN_SOURCE));
 
-  //clear gpio14 status
+  easygpio_interrupts[gpio_pin].handler = interruptHandler;
+  easygpio_interrupts[gpio_pin].arg = interruptArg;
+  easygpio_attachedPins |= BIT(gpio_pin);
+
+  //clear gpio status
   GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(gpio_pin));
   ETS_GPIO_INTR_ENABLE();
 
@@ -249,14 +253,18 @@ easygpio_attachInterrupt(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, void
 bool ICACHE_FLASH_ATTR
 easygpio_detachInterrupt(uint8_t gpio_pin) {
 
-  if (gpio_pin == 16) {
-    os_printf("easygpio_setupInterrupt Error: GPIO16 does not have interrupts\n");
+  if (gpio_pin >= EASYGPIO_INTERRUPT_PINS) {
+    EASYGPIO_LOG_ERROR("easygpio_detachInterrupt Error: GPIO%d does not have interrupts\n", gpio_pin);
     return false;
   }
 
-  // Don't know how to detach interrupt, yet.
-  // Quick and dirty fix - just disable the interrupt
+  ETS_GPIO_INTR_DISABLE();
   gpio_pin_intr_state_set(GPIO_ID_PIN(gpio_pin), GPIO_PIN_INTR_DISABLE);
+  easygpio_attachedPins &= ~BIT(gpio_pin);
+  easygpio_interrupts[gpio_pin].handler = NULL;
+  easygpio_interrupts[gpio_pin].arg = NULL;
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(gpio_pin));
+  ETS_GPIO_INTR_ENABLE();
   return true;
 }
 
@@ -267,40 +275,52 @@ easygpio_detachInterrupt(uint8_t gpio_pin) {
  * Use easygpio_outputEnable() to change an input gpio to output mode.
  */
 void
-easygpio_outputSet(uint8_t gpio_pin, uint8_t value) {
-  if (16==gpio_pin) {
-    WRITE_PERI_REG(RTC_GPIO_OUT,
-                   (READ_PERI_REG(RTC_GPIO_OUT) & 0xfffffffeUL) | (0x1UL & value));
-  } else {
+(easygpio_outputSet)(uint8_t gpio_pin, uint8_t value) {
 #ifdef EASYGPIO_USE_GPIO_OUTPUT_SET
+  if (16!=gpio_pin) {
     GPIO_OUTPUT_SET(GPIO_ID_PIN(gpio_pin), value);
-#else
-    if (value&1){
-      WRITE_PERI_REG( PERIPHS_GPIO_BASEADDR, READ_PERI_REG(PERIPHS_GPIO_BASEADDR) | BIT(gpio_pin));
-    } else {
-      WRITE_PERI_REG( PERIPHS_GPIO_BASEADDR, READ_PERI_REG(PERIPHS_GPIO_BASEADDR) & ~BIT(gpio_pin));
-    }
+    return;
+  }
 #endif
+  // the set and clear registers don't need a read-modify-write
+  easygpio_outputSetInline(gpio_pin, value);
+}
+
+/**
+ * Sets the output value of every pin in 'setMask' high and of every pin in 'clearMask' low,
+ * one register write each. Handles GPIO 0-15, the pins in 'setMask' all change on the same cycle.
+ * Just like easygpio_outputSet() this doesn't switch the pins to outputs.
+ */
+void
+easygpio_outputSetMask(uint32_t setMask, uint32_t clearMask) {
+  if (setMask) {
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, setMask & EASYGPIO_GPIO_PIN_MASK);
+  }
+  if (clearMask) {
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, clearMask & EASYGPIO_GPIO_PIN_MASK);
   }
 }
 
 /**
  * Uniform way of getting GPIO input value. Handles GPIO 0-16.
  * The pin must be initiated with easygpio_pinMode() so that the pin mux is setup as a gpio in the first place.
- * If you know that you won't be using GPIO16 then you'd better off by just using GPIO_INPUT_GET().
  */
 uint8_t
-easygpio_inputGet(uint8_t gpio_pin) {
-  if (16==gpio_pin) {
-    return (READ_PERI_REG(RTC_GPIO_IN_DATA) & 1UL);
-  } else {
+(easygpio_inputGet)(uint8_t gpio_pin) {
 #ifdef EASYGPIO_USE_GPIO_INPUT_GET
+  if (16!=gpio_pin) {
     return GPIO_INPUT_GET(GPIO_ID_PIN(gpio_pin));
-#else
-  // this does *not* work, maybe GPIO_IN_ADDRESS is the wrong address
-  return ((GPIO_REG_READ(GPIO_IN_ADDRESS) > gpio_pin)  & 1UL);
-#endif
   }
+#endif
+  return easygpio_inputGetInline(gpio_pin);
+}
+
+/**
+ * Returns the input values of GPIO 0-15 as a mask, bit n is GPIOn, with a single register read.
+ */
+uint32_t
+easygpio_inputGetMask(void) {
+  return GPIO_REG_READ(GPIO_IN_ADDRESS) & EASYGPIO_GPIO_PIN_MASK;
 }
 
 /**
@@ -308,7 +328,7 @@ easygpio_inputGet(uint8_t gpio_pin) {
  * The pin must be initiated with easygpio_pinMode() so that the pin mux is setup as a gpio in the first place.
  * This function does the same thing as GPIO_DIS_OUTPUT, but works on GPIO16 too.
  */
-void easygpio_outputDisable(uint8_t gpio_pin) {
+void (easygpio_outputDisable)(uint8_t gpio_pin) {
   if (16==gpio_pin) {
     WRITE_PERI_REG(RTC_GPIO_ENABLE,
         READ_PERI_REG(RTC_GPIO_ENABLE) & 0xfffffffeUL);  //out disable
@@ -327,7 +347,7 @@ void easygpio_outputDisable(uint8_t gpio_pin) {
  *    function to just change output value.
  *  - does the same thing as GPIO_OUTPUT_SET, but works on GPIO16 too.
  */
-void easygpio_outputEnable(uint8_t gpio_pin, uint8_t value) {
+void (easygpio_outputEnable)(uint8_t gpio_pin, uint8_t value) {
   if (16==gpio_pin) {
     // write the value before flipping to output
     // - so we don't flash previous value for a few ns.
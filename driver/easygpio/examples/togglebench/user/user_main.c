@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2015, eadf (https://github.com/eadf)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of Redis nor the names of its contributors may be used
+ * to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <osapi.h>
+#include <os_type.h>
+#include "user_interface.h"
+#include "gpio.h"
+#include "easygpio/easygpio.h"
+#include "stdout/stdout.h"
+
+// Measures how many output toggles (and input reads) per second the per pin calls and the
+// mask calls manage. Connect nothing to the pins, they are driven as outputs.
+
+#define BENCH_PERIOD 5000 // 5000 ms between each run
+#define BENCH_LOOPS 10000
+static os_timer_t bench_timer;
+uint8_t pinsToTest[] = {4,5,12,13};
+uint8_t pinsToTestLen = 4;
+
+static inline uint32_t
+getCycleCount(void) {
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0,ccount":"=a" (ccount));
+  return ccount;
+}
+
+/**
+ * Prints the result of a run of BENCH_LOOPS loops over every pin.
+ */
+static void ICACHE_FLASH_ATTR
+report(const char *name, uint32_t cycles) {
+  uint32_t pinOperations = BENCH_LOOPS * pinsToTestLen;
+  uint32_t perSecond = (uint32_t)(((uint64_t) pinOperations * system_get_cpu_freq() * 1000000) / cycles);
+  os_printf("%s: %d cycles per pin, %d pins per second\n", name, cycles / pinOperations, perSecond);
+}
+
+static void ICACHE_FLASH_ATTR
+loop(void) {
+  uint32_t mask = 0;
+  uint32_t start = 0;
+  uint32_t sink = 0;
+  uint32_t i = 0;
+  uint8_t p = 0;
+
+  for (p=0; p<pinsToTestLen; p++) {
+    mask |= BIT(pinsToTest[p]);
+  }
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    for (p=0; p<pinsToTestLen; p++) {
+      easygpio_outputSet(pinsToTest[p], i & 1);
+    }
+  }
+  report("easygpio_outputSet", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    // constant pins, inlined to one register write each
+    easygpio_outputSet(4, i & 1);
+    easygpio_outputSet(5, i & 1);
+    easygpio_outputSet(12, i & 1);
+    easygpio_outputSet(13, i & 1);
+  }
+  report("easygpio_outputSet(constant pin)", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    for (p=0; p<pinsToTestLen; p++) {
+      GPIO_OUTPUT_SET(pinsToTest[p], i & 1);
+    }
+  }
+  report("GPIO_OUTPUT_SET", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    if (i & 1) {
+      easygpio_outputSetMask(mask, 0);
+    } else {
+      easygpio_outputSetMask(0, mask);
+    }
+  }
+  report("easygpio_outputSetMask", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    for (p=0; p<pinsToTestLen; p++) {
+      sink += easygpio_inputGet(pinsToTest[p]);
+    }
+  }
+  report("easygpio_inputGet", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    sink += easygpio_inputGetMask() & mask;
+  }
+  report("easygpio_inputGetMask", getCycleCount() - start);
+  os_printf("(%d)\n\n", sink & 1);
+}
+
+void ICACHE_FLASH_ATTR
+setup(void) {
+  uint8_t i=0;
+  for (i=0; i<pinsToTestLen; i++) {
+    os_printf("Setting gpio%d as output\n", pinsToTest[i]);
+    easygpio_pinMode(pinsToTest[i], EASYGPIO_NOPULL, EASYGPIO_OUTPUT);
+  }
+  os_printf("Starting the toggle benchmark:\n");
+  os_timer_disarm(&bench_timer);
+  os_timer_setfn(&bench_timer, (os_timer_func_t *)loop, NULL);
+  os_timer_arm(&bench_timer, BENCH_PERIOD, true);
+}
+
+void ICACHE_FLASH_ATTR
+user_init(void)
+{
+  // Make uart0 work with just the TX pin. Baud:115200,n,8,1
+  stdout_init();
+
+  // turn off WiFi, it would steal cycles from the benchmark
+  wifi_station_set_auto_connect(false);
+  wifi_station_disconnect();
+
+  gpio_init();
+  os_timer_disarm(&bench_timer);
+  os_timer_setfn(&bench_timer, (os_timer_func_t *)setup, NULL);
+  os_timer_arm(&bench_timer, 2000, false);
+}
@@ -33,6 +33,7 @@
 #define EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_H_
 
 #include "c_types.h"
+#include "eagle_soc.h"
 
 typedef enum {
   EASYGPIO_INPUT=0,
@@ -53,11 +54,14 @@ bool easygpio_getGPIONameFunc(uint8_t gpio_pin, uint32_t *gpio_name, uint8_t *gp
  * Sets the 'gpio_pin' pin as a GPIO and sets the interrupt to trigger on that pin.
  * The 'interruptArg' is the function argument that will be sent to your interruptHandler
  * (this way you can several interrupts with one interruptHandler)
+ * Every pin has its own handler, so several drivers can use GPIO interrupts at the same time,
+ * as long as they all go through easygpio. The interrupt status of the pin is already
+ * cleared when interruptHandler is called. Don't call ETS_GPIO_INTR_ATTACH() yourself.
  */
 bool easygpio_attachInterrupt(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus, void (*interruptHandler)(void *arg), void *interruptArg);
 
 /**
- * Deatach the interrupt handler from the 'gpio_pin' pin.
+ * Deatach the interrupt handler from the 'gpio_pin' pin, and disables the interrupt of the pin.
  */
 bool easygpio_detachInterrupt(uint8_t gpio_pin);
 
@@ -80,10 +84,14 @@ bool easygpio_pullMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus);
 /**
  * Uniform way of getting GPIO input value. Handles GPIO 0-16.
  * The pin must be initiated with easygpio_pinMode() so that the pin mux is setup as a gpio in the first place.
- * If you know that you won't be using GPIO16 then you'd better off by just using GPIO_INPUT_GET().
  */
 uint8_t easygpio_inputGet(uint8_t gpio_pin);
 
+/**
+ * Returns the input values of GPIO 0-15 as a mask, bit n is GPIOn, with a single register read.
+ */
+uint32_t easygpio_inputGetMask(void);
+
 /**
  * Uniform way of setting GPIO output value. Handles GPIO 0-16.
  *
@@ -92,6 +100,13 @@ uint8_t easygpio_inputGet(uint8_t gpio_pin);
  */
 void easygpio_outputSet(uint8_t gpio_pin, uint8_t value);
 
+/**
+ * Sets the output value of every pin in 'setMask' high and of every pin in 'clearMask' low,
+ * one register write each. Handles GPIO 0-15, the pins in 'setMask' all change on the same cycle.
+ * Just like easygpio_outputSet() this doesn't switch the pins to outputs.
+ */
+void easygpio_outputSetMask(uint32_t setMask, uint32_t clearMask);
+
 /**
  * Uniform way of turning an output GPIO pin into input mode. Handles GPIO 0-16.
  * The pin must be initiated with easygpio_pinMode() so that the pin mux is setup as a gpio in the first place.
@@ -111,4 +126,68 @@ void easygpio_outputDisable(uint8_t gpio_pin);
  */
 void easygpio_outputEnable(uint8_t gpio_pin, uint8_t value);
 
+/**
+ * True if 'gpio_pin' is a GPIO that can be used, GPIO6-8 and GPIO11 are taken by the flash.
+ */
+#define EASYGPIO_IS_GPIO(gpio_pin) ((gpio_pin) <= 16 && ((gpio_pin) < 6 || (gpio_pin) > 8) && (gpio_pin) != 11)
+
+/**
+ * Never defined: a call to it that the compiler can't remove stops the build.
+ */
+void easygpio_noSuchGPIO(void) __attribute__((error("there is no such GPIO, GPIO6-8 and GPIO11 are used by the flash")));
+
+/**
+ * Rejects an invalid 'gpio_pin' at compile time when it is a constant, does nothing otherwise.
+ */
+#define EASYGPIO_CHECK_PIN(gpio_pin) \
+  ((void)((__builtin_constant_p(gpio_pin) && !EASYGPIO_IS_GPIO(gpio_pin)) ? (easygpio_noSuchGPIO(), 0) : 0))
+
+/**
+ * The inline version of easygpio_outputSet(). With a constant pin and value this is a single register write,
+ * and it is safe to use from IRAM code since nothing is called.
+ */
+static inline void __attribute__((always_inline))
+easygpio_outputSetInline(uint8_t gpio_pin, uint8_t value) {
+  if (16==gpio_pin) {
+    WRITE_PERI_REG(RTC_GPIO_OUT,
+                   (READ_PERI_REG(RTC_GPIO_OUT) & 0xfffffffeUL) | (0x1UL & value));
+  } else if (value&1) {
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, BIT(gpio_pin));
+  } else {
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, BIT(gpio_pin));
+  }
+}
+
+/**
+ * The inline version of easygpio_inputGet(). With a constant pin this is a single register read.
+ */
+static inline uint8_t __attribute__((always_inline))
+easygpio_inputGetInline(uint8_t gpio_pin) {
+  if (16==gpio_pin) {
+    return READ_PERI_REG(RTC_GPIO_IN_DATA) & 1UL;
+  }
+  return (GPIO_REG_READ(GPIO_IN_ADDRESS) >> gpio_pin) & 1UL;
+}
+
+/*
+ * Calls with a constant pin are checked at compile time, the output and input calls also
+ * fold down to the inline versions. Calls with a variable pin go to the functions.
+ */
+#define easygpio_pinMode(gpio_pin, pullStatus, pinMode) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), (easygpio_pinMode)(gpio_pin, pullStatus, pinMode))
+#define easygpio_pullMode(gpio_pin, pullStatus) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), (easygpio_pullMode)(gpio_pin, pullStatus))
+#define easygpio_attachInterrupt(gpio_pin, pullStatus, interruptHandler, interruptArg) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), (easygpio_attachInterrupt)(gpio_pin, pullStatus, interruptHandler, interruptArg))
+#define easygpio_outputEnable(gpio_pin, value) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), (easygpio_outputEnable)(gpio_pin, value))
+#define easygpio_outputDisable(gpio_pin) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), (easygpio_outputDisable)(gpio_pin))
+#define easygpio_outputSet(gpio_pin, value) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), __builtin_constant_p(gpio_pin) ? \
+      easygpio_outputSetInline(gpio_pin, value) : (easygpio_outputSet)(gpio_pin, value))
+#define easygpio_inputGet(gpio_pin) \
+  (EASYGPIO_CHECK_PIN(gpio_pin), __builtin_constant_p(gpio_pin) ? \
+      easygpio_inputGetInline(gpio_pin) : (easygpio_inputGet)(gpio_pin))
+
 #endif /* EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_H_ */
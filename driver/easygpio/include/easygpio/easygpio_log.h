@@ -0,0 +1,99 @@
+/*
+* easygpio_log.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_LOG_H_
+#define EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_LOG_H_
+
+#include "osapi.h"
+#include "user_interface.h"
+
+/**
+ * Leveled, rate limited logging for easygpio. Messages above EASYGPIO_LOG_LEVEL compile to nothing.
+ * The Makefile sets the level from FLAVOR (debug: everything, release: errors only).
+ * Every call site prints at most one message per EASYGPIO_LOG_INTERVAL (microseconds), the number
+ * of messages it suppressed in between is printed with the next one.
+ */
+#define EASYGPIO_LOG_LEVEL_NONE  0
+#define EASYGPIO_LOG_LEVEL_ERROR 1
+#define EASYGPIO_LOG_LEVEL_WARN  2
+#define EASYGPIO_LOG_LEVEL_INFO  3
+#define EASYGPIO_LOG_LEVEL_DEBUG 4
+
+#ifndef EASYGPIO_LOG_LEVEL
+#define EASYGPIO_LOG_LEVEL EASYGPIO_LOG_LEVEL_ERROR
+#endif
+
+#ifndef EASYGPIO_LOG_INTERVAL
+#define EASYGPIO_LOG_INTERVAL 1000000 // 1 s
+#endif
+
+typedef struct {
+  uint32_t last;
+  uint16_t suppressed;
+  bool hasPrinted;
+} Easygpio_LogSite;
+
+/**
+ * Returns true if the call site may print now, otherwise counts a suppressed message.
+ */
+static inline bool ICACHE_FLASH_ATTR
+easygpio_logAllow(Easygpio_LogSite *site) {
+  uint32_t now = system_get_time();
+  if (site->hasPrinted && now - site->last < EASYGPIO_LOG_INTERVAL) {
+    if (site->suppressed < 0xffff) {
+      site->suppressed++;
+    }
+    return false;
+  }
+  if (site->suppressed) {
+    os_printf("(easygpio: %d messages suppressed) ", site->suppressed);
+    site->suppressed = 0;
+  }
+  site->last = now;
+  site->hasPrinted = true;
+  return true;
+}
+
+#define EASYGPIO_LOG(level, ...) do { \
+    if ((level) <= EASYGPIO_LOG_LEVEL) { \
+      static Easygpio_LogSite site_; \
+      if (easygpio_logAllow(&site_)) { \
+        os_printf(__VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
+#define EASYGPIO_LOG_ERROR(...) EASYGPIO_LOG(EASYGPIO_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define EASYGPIO_LOG_WARN(...)  EASYGPIO_LOG(EASYGPIO_LOG_LEVEL_WARN, __VA_ARGS__)
+#define EASYGPIO_LOG_INFO(...)  EASYGPIO_LOG(EASYGPIO_LOG_LEVEL_INFO, __VA_ARGS__)
+#define EASYGPIO_LOG_DEBUG(...) EASYGPIO_LOG(EASYGPIO_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif /* EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_LOG_H_ */
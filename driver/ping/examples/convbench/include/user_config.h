@@ -0,0 +1,4 @@
+#ifndef __USER_CONFIG_H__
+#define __USER_CONFIG_H__
+
+#endif
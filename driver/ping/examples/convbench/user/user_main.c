@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015, eadf (https://github.com/eadf)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of Redis nor the names of its contributors may be used
+ * to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <osapi.h>
+#include <os_type.h>
+#include "user_interface.h"
+#include "gpio.h"
+#include "ping/ping.h"
+#include "stdout/stdout.h"
+
+// Measures the CPU cycles the distance conversions take on the lx106, which has no FPU:
+// the float math of ping_ping() against the fixed point math of ping_pingMm() and
+// ping_pingTenthMm(). Each conversion turns a max distance into a time out and an echo
+// time into a distance, like one ping does. Nothing needs to be connected to the pins.
+
+#define BENCH_PERIOD 5000 // 5000 ms between each run
+#define BENCH_LOOPS 10000
+#define MAX_DISTANCE 3000 // mm
+static os_timer_t bench_timer;
+static Ping_Data pingData;
+
+// volatile, so that the compiler can't fold the conversions of a known echo time
+static volatile uint32_t echoTimes[] = {580, 1160, 2900, 5800, 11600, 17400};
+#define ECHO_TIMES (sizeof(echoTimes)/sizeof(echoTimes[0]))
+
+static inline uint32_t
+getCycleCount(void) {
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0,ccount":"=a" (ccount));
+  return ccount;
+}
+
+/**
+ * What ping_ping() does around the ping: float max distance to time out, echo time to float distance.
+ * Out of line like the other two, so that every conversion pays for one call.
+ */
+static uint32_t __attribute__((noinline)) ICACHE_FLASH_ATTR
+convertFloat(uint32_t echoTime, float *distance) {
+  uint32_t maxPeriod = (float)MAX_DISTANCE * pingData.usPerUnit;
+  *distance = ((float) echoTime)*pingData.unitPerUs;
+  return maxPeriod;
+}
+
+/**
+ * What ping_pingMm() does around the ping.
+ */
+static uint32_t __attribute__((noinline)) ICACHE_FLASH_ATTR
+convertMm(uint32_t echoTime, uint32_t *distance) {
+  uint32_t maxPeriod = ping_tenthMmToUs(&pingData, MAX_DISTANCE*10);
+  *distance = ping_usToMm(&pingData, echoTime);
+  return maxPeriod;
+}
+
+/**
+ * What ping_pingTenthMm() does around the ping.
+ */
+static uint32_t __attribute__((noinline)) ICACHE_FLASH_ATTR
+convertTenthMm(uint32_t echoTime, uint32_t *distance) {
+  uint32_t maxPeriod = ping_tenthMmToUs(&pingData, MAX_DISTANCE*10);
+  *distance = ping_usToTenthMm(&pingData, echoTime);
+  return maxPeriod;
+}
+
+/**
+ * Prints the result of a run of BENCH_LOOPS conversions.
+ */
+static void ICACHE_FLASH_ATTR
+report(const char *name, uint32_t cycles) {
+  os_printf("%s: %d cycles per conversion at %d MHz\n", name, cycles / BENCH_LOOPS, system_get_cpu_freq());
+}
+
+static void ICACHE_FLASH_ATTR
+loop(void) {
+  uint32_t start = 0;
+  uint32_t sink = 0;
+  uint32_t distance = 0;
+  float floatDistance = 0;
+  uint32_t i = 0;
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    sink += convertFloat(echoTimes[i % ECHO_TIMES], &floatDistance);
+    sink += (uint32_t)floatDistance;
+  }
+  report("ping_ping (float)", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    sink += convertMm(echoTimes[i % ECHO_TIMES], &distance);
+    sink += distance;
+  }
+  report("ping_pingMm", getCycleCount() - start);
+
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    sink += convertTenthMm(echoTimes[i % ECHO_TIMES], &distance);
+    sink += distance;
+  }
+  report("ping_pingTenthMm", getCycleCount() - start);
+
+  // an empty loop, the overhead included in the numbers above
+  start = getCycleCount();
+  for (i=0; i<BENCH_LOOPS; i++) {
+    sink += echoTimes[i % ECHO_TIMES];
+  }
+  report("loop overhead", getCycleCount() - start);
+  os_printf("(%d)\n\n", sink & 1);
+}
+
+void ICACHE_FLASH_ATTR
+setup(void) {
+  // any two free pins, nothing is pinged
+  ping_init(&pingData, 4, 5, PING_MM);
+  // not the default speed of sound, like a real installation
+  ping_setAmbient(NULL, 15, 50);
+  os_printf("Starting the conversion benchmark:\n");
+  os_timer_disarm(&bench_timer);
+  os_timer_setfn(&bench_timer, (os_timer_func_t *)loop, NULL);
+  os_timer_arm(&bench_timer, BENCH_PERIOD, true);
+}
+
+void ICACHE_FLASH_ATTR
+user_init(void)
+{
+  // Make uart0 work with just the TX pin. Baud:115200,n,8,1
+  stdout_init();
+
+  // turn off WiFi, it would steal cycles from the benchmark
+  wifi_station_set_auto_connect(false);
+  wifi_station_disconnect();
+
+  gpio_init();
+  os_timer_disarm(&bench_timer);
+  os_timer_setfn(&bench_timer, (os_timer_func_t *)setup, NULL);
+  os_timer_arm(&bench_timer, 2000, false);
+}
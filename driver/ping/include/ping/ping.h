@@ -33,9 +33,29 @@
 #define PING_INCLUDE_PING_PING_H_
 
 #include "c_types.h"
+#include "os_type.h"
+#include "user_config.h" // PING_LATENCY_STATS
 
 #define PING_US_TO_MM (1.0/5.8)
 #define PING_US_TO_INCH (1.0/148.0)
+#define PING_DEFAULT_SOUND_SPEED 344828 // mm/s, what PING_US_TO_MM assumes
+
+// Temperature range of ping_setAmbient()
+#define PING_MIN_CELSIUS -40
+#define PING_MAX_CELSIUS 85
+#define PING_AMBIENT_UNSET (-32768)
+
+// Fractional bits of the fixed point conversion factors in Ping_Data
+#define PING_US_TO_MM_SHIFT 16
+#define PING_US_TO_TENTH_MM_SHIFT 14
+#define PING_TENTH_MM_TO_US_SHIFT 16
+
+// Longest distance ping_tenthMmToUs() converts (10 m), longer ones are clamped.
+// The product with tenthMmToUs still fits 32 bits at the slowest speed of sound (-40 C).
+#define PING_MAX_TENTH_MM 100000
+
+// Most sensors ping_startAsyncGroup() can start, one bit each in the returned mask
+#define PING_MAX_GROUP_SIZE 16
 
 typedef enum {
   PING_MM = 0,
@@ -43,13 +63,136 @@ typedef enum {
   PING_US      // return time instead of distance (inverted Kessel run, anyone?)
 } Ping_Unit;
 
+typedef enum {
+  PING_STATE_IDLE = 0,
+  PING_STATE_WAIT_ECHO,  // trigger sent (or about to be, once the echo pin has gone low), waiting for the echo to start
+  PING_STATE_ECHO,       // echo started, waiting for it to end
+  PING_STATE_DONE        // result is waiting to be picked up by ping_pingUs()
+} Ping_State;
+
+/**
+ * The outcome of a ping.
+ */
+typedef enum {
+  PING_STATUS_OK = 0,
+  PING_STATUS_NO_ECHO,        // timed out waiting for the echo to start
+  PING_STATUS_ECHO_TOO_LONG,  // timed out waiting for the echo to end
+  PING_STATUS_STUCK_HIGH,     // the echo pin of a previous ping never went low, wake up pulses were sent
+  PING_STATUS_TOO_SHORT,      // echo shorter than 50 us, probably a previous echo
+  PING_STATUS_BUSY,           // another ping was already running
+  PING_STATUS_NOT_INITIATED,
+  PING_STATUS_COUNT
+} Ping_Status;
+
+/**
+ * Per sensor statistics, see ping_getStats().
+ * PING_STATUS_NOT_INITIATED is never counted, the statistics only exist after ping_init().
+ */
+typedef struct {
+  uint32_t outcomes[PING_STATUS_COUNT]; // number of pings per Ping_Status
+  uint32_t minEchoTime;                 // us, of the successful pings
+  uint32_t maxEchoTime;
+  uint32_t meanEchoTime;                // only set in snapshots
+  uint64_t sumEchoTime;
+  uint32_t spuriousInterrupts;          // edges on the echo pin when no ping was listening, only set in snapshots
+} Ping_Stats;
+
+#define PING_LATENCY_BUCKETS 16
+
+/**
+ * Interrupt latency histograms of an echo pin, see PING_LATENCY_STATS.
+ * Bucket i counts the latencies of 2^i to 2^(i+1)-1 PING_TICKS() (bucket 0 also counts 0),
+ * the last bucket counts everything longer.
+ */
+typedef struct {
+  uint32_t gpio[PING_LATENCY_BUCKETS];  // from a software raised edge to the GPIO handler, see ping_latencyProbe()
+  uint32_t timer[PING_LATENCY_BUCKETS]; // from a channel deadline to the FRC1 handler, 1us resolution
+  uint8_t ticksPerUs;
+} Ping_LatencyHistogram;
+
+typedef struct Ping_Data Ping_Data;
+typedef struct Ping_Tracker Ping_Tracker;
+
+/**
+ * Called (from task context, never from the interrupt handler) when an asynchronous ping has completed.
+ * 'echoTime' is the echo time in microseconds, it is only valid when 'success' is true.
+ */
+typedef void (*Ping_Callback)(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg);
+
+/**
+ * Called (from task context) when a burst has completed, see ping_burst().
+ * 'results' holds the echo times in microseconds, 0 for the failed pings.
+ */
+typedef void (*Ping_BurstCallback)(Ping_Data *pingData, uint8_t successes, uint32_t results[], void *arg);
+
+/**
+ * The progress of a burst, see ping_burst().
+ */
 typedef struct {
+  // 'private' data, don't change anything in here
+  uint32_t *results;
+  uint32_t maxPeriod;
+  uint8_t n;
+  uint8_t done;       // pings completed so far
+  uint8_t successes;
+  Ping_BurstCallback callback;
+  void *arg;
+} Ping_Burst;
+
+struct Ping_Data {
   // 'private' data, don't change anything in here
   int8_t echoPin;
   int8_t triggerPin;
   bool isInitiated;
   Ping_Unit unit;
-} Ping_Data;
+
+  // conversion factors, set up by ping_init()
+  uint32_t usToMm;      // PING_US_TO_MM_SHIFT fixed point
+  uint32_t usToTenthMm; // PING_US_TO_TENTH_MM_SHIFT fixed point
+  uint32_t tenthMmToUs; // PING_TENTH_MM_TO_US_SHIFT fixed point
+  float unitPerUs;
+  float usPerUnit;
+  int16_t celsius;       // PING_AMBIENT_UNSET: follow the global setting
+  uint8_t humidity;
+  uint32_t ambientGeneration;
+
+  // ping state
+  Ping_State state;
+  bool isAsync;
+  bool success;
+  uint32_t startTime;
+  uint8_t ticksPerUs;   // resolution of the time stamps
+  uint32_t timeStamp0;  // echo start, in CPU cycles or microseconds (see PING_CCOUNT_TIMESTAMPS)
+  uint32_t timeStamp1;  // echo end
+  Ping_Callback callback;
+  void *callbackArg;
+  Ping_Status status;    // outcome of the last ping
+  Ping_Stats stats;
+  Ping_Tracker *tracker; // see ping_tracker.h
+
+  // adaptive time out, see ping_setAdaptiveTimeout()
+  bool isAdaptive;
+  uint8_t adaptiveCount;    // successful pings in the current block
+  uint8_t adaptiveProbe;    // pings since the full range was last probed
+  uint32_t adaptiveMax[2];  // longest echo time of the current and of the previous block
+  uint32_t maxPeriod;       // the time out asked for
+  uint32_t timeout;         // the time out actually used
+  uint32_t shortenedTimeouts;
+  uint32_t savedTime;       // us not spent waiting thanks to shortened time outs
+};
+
+/**
+ * Where the CPU time of the asynchronous pings goes.
+ * 'waitTime' is what a busy waiting ping would have spent, 'isrTime' is what the interrupt handlers spent.
+ */
+typedef struct {
+  uint32_t pings;    // number of completed asynchronous pings
+  uint32_t waitTime; // us from start to result, summed over all the asynchronous pings
+  uint32_t isrTime;  // us spent in the GPIO and FRC1 interrupt handlers
+  uint32_t isrCount; // number of interrupt handler invocations
+  uint32_t echoIsrCount;  // of which the echo (GPIO) interrupt handler, the edges
+  uint32_t echoIsrCycles; // CPU cycles spent in the echo interrupt handler
+} Ping_BusyStats;
 
 /**
  * Sends a ping, and returns the number of microseconds it took to receive a response.
@@ -57,12 +200,143 @@ typedef struct {
  */
 bool ping_pingUs(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response);
 
+/**
+ * Sends a ping, and returns the number of nanoseconds it took to receive a response.
+ * Will give up after maxPeriod microseconds (with false as return value)
+ * Define PING_CCOUNT_TIMESTAMPS in user_config.h to get better than microsecond resolution.
+ */
+bool ping_pingNs(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response);
+
+/**
+ * Starts 'n' asynchronous pings back to back, as fast as the reverberation of the previous echo
+ * allows. The echo times (in microseconds) are stored in 'results', 0 for failed pings, and
+ * 'callback' is called when the last ping has completed. 'burst' and 'results' must stay
+ * around until then.
+ * Returns false if the first ping could not be started (the callback will not be called).
+ */
+bool ping_burst(Ping_Burst *burst, Ping_Data *pingData, uint8_t n, uint32_t maxPeriod, uint32_t results[],
+    Ping_BurstCallback callback, void *arg);
+
+/**
+ * Starts a ping and returns immediately. 'callback' will be called from the
+ * ping task when the echo has been received, or when maxPeriod microseconds have passed.
+ * Returns false if the ping could not be started (the callback will not be called).
+ */
+bool ping_startAsync(Ping_Data *pingData, uint32_t maxPeriod, Ping_Callback callback, void *arg);
+
+/**
+ * Starts asynchronous pings on 'count' sensors at once, see ping_startAsync(). The trigger
+ * pulses of all the sensors that are ready start on the same cycle.
+ * At most PING_MAX_GROUP_SIZE sensors, the rest of 'sensors' is ignored.
+ * Returns a mask of the indexes (into 'sensors') of the pings that were started.
+ */
+uint16_t ping_startAsyncGroup(Ping_Data *sensors[], uint8_t count, uint32_t maxPeriod, Ping_Callback callback, void *arg);
+
+/**
+ * Returns true if an asynchronous ping is in progress on this sensor.
+ */
+bool ping_isBusy(Ping_Data *pingData);
+
+/**
+ * Returns a snapshot of the CPU time spent by the asynchronous pings, optionally resets the counters.
+ */
+void ping_getBusyStats(Ping_BusyStats *stats, bool reset);
+
+/**
+ * Returns the number of echo edges that were lost because the interrupt handler
+ * produced them faster than the ping task could process them.
+ * A ping that lost an edge fails, with PING_STATUS_NO_ECHO or PING_STATUS_ECHO_TOO_LONG.
+ */
+uint32_t ping_getEventOverflows(void);
+
 /**
  * Sends a ping, and returns the response in the specified unit (mm/inches)
  * returns false if no result could be found.
  */
 bool ping_ping(Ping_Data *pingData, float maxDistance, float* returnDistance);
 
+/**
+ * Sends a ping, and returns the response in millimeters.
+ * Uses integer math only, unlike ping_ping()
+ * returns false if no result could be found.
+ */
+bool ping_pingMm(Ping_Data *pingData, uint32_t maxDistance, uint32_t* returnDistance);
+
+/**
+ * Sends a ping, and returns the response in 1/10 millimeters.
+ * Uses integer math only, unlike ping_ping()
+ * returns false if no result could be found.
+ */
+bool ping_pingTenthMm(Ping_Data *pingData, uint32_t maxDistance, uint32_t* returnDistance);
+
+/**
+ * Converts an echo time (in microseconds) into millimeters.
+ * Like ping_usToTenthMm() and ping_pingMm(), the result is within one unit of what the
+ * float math of ping_ping() gives, the fixed point factors have limited precision.
+ */
+uint32_t ping_usToMm(Ping_Data *pingData, uint32_t echoTime);
+
+/**
+ * Converts an echo time (in microseconds) into 1/10 millimeters.
+ */
+uint32_t ping_usToTenthMm(Ping_Data *pingData, uint32_t echoTime);
+
+/**
+ * Converts a distance in 1/10 millimeters into an echo time (in microseconds).
+ * Distances above PING_MAX_TENTH_MM are clamped.
+ */
+uint32_t ping_tenthMmToUs(Ping_Data *pingData, uint32_t distance);
+
+/**
+ * Returns the outcome of the last ping of pingData, for when a ping function returned false.
+ */
+Ping_Status ping_getStatus(Ping_Data *pingData);
+
+/**
+ * Returns a snapshot of the outcome counters and echo time statistics of pingData,
+ * optionally resets them.
+ */
+void ping_getStats(Ping_Data *pingData, Ping_Stats *stats, bool reset);
+
+#ifdef PING_LATENCY_STATS
+/**
+ * Raises the GPIO interrupt of an (idle) echo pin from software, to measure the interrupt latency.
+ * Only available when PING_LATENCY_STATS is defined in user_config.h, as are the two below.
+ */
+void ping_latencyProbe(uint8_t pin);
+
+/**
+ * Returns a snapshot of the latency histograms of an echo pin, optionally resets them.
+ */
+void ping_getLatencyHistogram(uint8_t pin, Ping_LatencyHistogram *histogram, bool reset);
+
+/**
+ * Prints the latency histograms of every echo pin, for tools/ping_latency.py.
+ */
+void ping_latencyDump(bool reset);
+#endif
+
+/**
+ * Enables or disables the adaptive time out of a sensor. When enabled the time out of a ping is
+ * shrunk to a margin above the longest echo of the recent pings, with a ping using the full time
+ * out every PING_ADAPTIVE_PROBE_INTERVAL pings (and after every failed ping) to catch far targets.
+ */
+void ping_setAdaptiveTimeout(Ping_Data *pingData, bool enable);
+
+/**
+ * Returns the number of pings that timed out early thanks to the adaptive time out, and the
+ * time (us) that saved. Optionally resets the counters.
+ */
+void ping_getAdaptiveStats(Ping_Data *pingData, uint32_t *shortenedTimeouts, uint32_t *savedTime, bool reset);
+
+/**
+ * Sets the air temperature (celsius, -40 to 85) and relative humidity (%)
+ * used to convert echo times to distances.
+ * pingData==NULL sets it for every sensor without a setting of its own.
+ * celsius==PING_AMBIENT_UNSET reverts to the default (PING_US_TO_MM).
+ */
+void ping_setAmbient(Ping_Data *pingData, int16_t celsius, uint8_t humidity);
+
 /**
  * Initiates the GPIOs.
  * Set triggerPin and echoPin to the same value for one-pin mode.
@@ -0,0 +1,81 @@
+/*
+* ping_filter.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PING_INCLUDE_PING_PING_FILTER_H_
+#define PING_INCLUDE_PING_PING_FILTER_H_
+
+#include "c_types.h"
+
+#define PING_FILTER_MAX_WINDOW 15
+
+typedef struct {
+  // 'private' data, don't change anything in here
+  uint8_t window;
+  uint8_t count;     // number of samples in the window
+  uint8_t head;      // index of the oldest sample in 'ring'
+  uint8_t rejectedInARow;
+  uint8_t madGate;   // outliers are more than madGate*MAD from the median, 0 disables the gate
+  uint32_t minDeviation; // the MAD is never considered smaller than this
+  uint32_t ring[PING_FILTER_MAX_WINDOW];   // the samples in arrival order
+  uint32_t sorted[PING_FILTER_MAX_WINDOW]; // the same samples, sorted
+
+  uint32_t accepted;
+  uint32_t rejected; // outliers
+  uint32_t dropouts; // failed pings
+} Ping_Filter;
+
+/**
+ * Initiates the filter with a window of 'window' samples (1 to PING_FILTER_MAX_WINDOW).
+ * Samples further away from the median than 'madGate' times the median absolute
+ * deviation (but at least 'madGate*minDeviation') are rejected as outliers.
+ * Use madGate=0 for a plain median filter.
+ */
+bool ping_filterInit(Ping_Filter *filter, uint8_t window, uint8_t madGate, uint32_t minDeviation);
+
+/**
+ * Feeds the result of a ping into the filter, 'success' and 'value' as given to a
+ * Ping_Callback (or returned by any of the ping_ping* functions).
+ * Returns false if there is no filtered value yet, otherwise the median of the
+ * window is stored in 'filtered'.
+ */
+bool ping_filterUpdate(Ping_Filter *filter, bool success, uint32_t value, uint32_t *filtered);
+
+/**
+ * Returns the median absolute deviation of the samples in the window.
+ */
+uint32_t ping_filterMad(Ping_Filter *filter);
+
+/**
+ * Empties the window.
+ */
+void ping_filterReset(Ping_Filter *filter);
+
+#endif /* PING_INCLUDE_PING_PING_FILTER_H_ */
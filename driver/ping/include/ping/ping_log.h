@@ -0,0 +1,99 @@
+/*
+* ping_log.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PING_INCLUDE_PING_PING_LOG_H_
+#define PING_INCLUDE_PING_PING_LOG_H_
+
+#include "osapi.h"
+#include "user_interface.h"
+
+/**
+ * Leveled, rate limited logging for the ping driver. Messages above PING_LOG_LEVEL compile to nothing.
+ * The Makefile sets the level from FLAVOR (debug: everything, release: errors only).
+ * Every call site prints at most one message per PING_LOG_INTERVAL (microseconds), the number
+ * of messages it suppressed in between is printed with the next one.
+ */
+#define PING_LOG_LEVEL_NONE  0
+#define PING_LOG_LEVEL_ERROR 1
+#define PING_LOG_LEVEL_WARN  2
+#define PING_LOG_LEVEL_INFO  3
+#define PING_LOG_LEVEL_DEBUG 4
+
+#ifndef PING_LOG_LEVEL
+#define PING_LOG_LEVEL PING_LOG_LEVEL_ERROR
+#endif
+
+#ifndef PING_LOG_INTERVAL
+#define PING_LOG_INTERVAL 1000000 // 1 s
+#endif
+
+typedef struct {
+  uint32_t last;
+  uint16_t suppressed;
+  bool hasPrinted;
+} Ping_LogSite;
+
+/**
+ * Returns true if the call site may print now, otherwise counts a suppressed message.
+ */
+static inline bool ICACHE_FLASH_ATTR
+ping_logAllow(Ping_LogSite *site) {
+  uint32_t now = system_get_time();
+  if (site->hasPrinted && now - site->last < PING_LOG_INTERVAL) {
+    if (site->suppressed < 0xffff) {
+      site->suppressed++;
+    }
+    return false;
+  }
+  if (site->suppressed) {
+    os_printf("(ping: %d messages suppressed) ", site->suppressed);
+    site->suppressed = 0;
+  }
+  site->last = now;
+  site->hasPrinted = true;
+  return true;
+}
+
+#define PING_LOG(level, ...) do { \
+    if ((level) <= PING_LOG_LEVEL) { \
+      static Ping_LogSite site_; \
+      if (ping_logAllow(&site_)) { \
+        os_printf(__VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
+#define PING_LOG_ERROR(...) PING_LOG(PING_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define PING_LOG_WARN(...)  PING_LOG(PING_LOG_LEVEL_WARN, __VA_ARGS__)
+#define PING_LOG_INFO(...)  PING_LOG(PING_LOG_LEVEL_INFO, __VA_ARGS__)
+#define PING_LOG_DEBUG(...) PING_LOG(PING_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif /* PING_INCLUDE_PING_PING_LOG_H_ */
@@ -0,0 +1,115 @@
+/*
+* ping_scheduler.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PING_INCLUDE_PING_PING_SCHEDULER_H_
+#define PING_INCLUDE_PING_PING_SCHEDULER_H_
+
+#include "ping/ping.h"
+
+#define PING_SCHEDULER_MAX_SENSORS 16
+
+typedef enum {
+  PING_SCHEDULER_IDLE = 0,
+  PING_SCHEDULER_RUNNING,
+  PING_SCHEDULER_LEARN_BASELINE, // firing the sensors one by one
+  PING_SCHEDULER_LEARN_PAIRS     // firing the sensors two by two
+} Ping_SchedulerState;
+
+typedef struct {
+  // 'private' data, don't change anything in here
+  Ping_Data *sensors[PING_SCHEDULER_MAX_SENSORS];
+  uint8_t numberOfSensors;
+  uint16_t interference[PING_SCHEDULER_MAX_SENSORS]; // bit j of interference[i] is set if sensor i and j can hear each other
+  uint16_t groups[PING_SCHEDULER_MAX_SENSORS]; // the fire groups, as masks of sensor indexes
+  uint8_t numberOfGroups;
+  uint8_t currentGroup;
+  uint16_t pending; // the sensors of the current round that have not reported back yet
+  uint32_t maxPeriod;
+  uint32_t groupDelay; // ms to wait between two fire groups
+  Ping_Callback callback;
+  void *callbackArg;
+  os_timer_t timer;
+
+  Ping_SchedulerState state;
+  // learning state
+  uint8_t learnA;
+  uint8_t learnB;
+  uint16_t baselineOk; // bit i is set if sensor i got an echo when fired alone
+  uint32_t baseline[PING_SCHEDULER_MAX_SENSORS]; // echo time of each sensor when fired alone
+  uint16_t resultOk;
+  uint32_t result[PING_SCHEDULER_MAX_SENSORS];
+
+  uint32_t rounds; // number of completed fire group rounds
+  uint32_t samples; // number of results delivered to the callback
+} Ping_Scheduler;
+
+/**
+ * Initiates the scheduler. Every result will be delivered to 'callback', just like ping_startAsync() does.
+ * maxPeriod is the time out in microseconds of each ping.
+ */
+void ping_schedulerInit(Ping_Scheduler *scheduler, uint32_t maxPeriod, Ping_Callback callback, void *arg);
+
+/**
+ * Adds an initiated sensor to the scheduler. Returns the index of the sensor or -1 if the scheduler is full.
+ * Sensors are assumed to not interfere with each other until told otherwise.
+ */
+int8_t ping_schedulerAdd(Ping_Scheduler *scheduler, Ping_Data *pingData);
+
+/**
+ * Declares that sensor 'a' and sensor 'b' (as indexes returned by ping_schedulerAdd()) can hear each other.
+ */
+void ping_schedulerSetInterference(Ping_Scheduler *scheduler, uint8_t a, uint8_t b, bool interferes);
+
+/**
+ * Sets the time (in ms) to wait between two fire groups, to let the echoes of the previous group die out.
+ */
+void ping_schedulerSetGroupDelay(Ping_Scheduler *scheduler, uint32_t ms);
+
+/**
+ * Measures which sensors that can hear each other. Every sensor is fired alone, and then every pair of
+ * sensors is fired together. A pair interferes if the result of any of the two differs from when it was
+ * fired alone. The learned interference is added to the declared one, and the scheduler starts running
+ * when done. Nothing is delivered to the callback while learning.
+ * The sensors must be pointing at something static while learning.
+ */
+bool ping_schedulerLearn(Ping_Scheduler *scheduler);
+
+/**
+ * Packs the sensors into fire groups and starts cycling through them.
+ */
+bool ping_schedulerStart(Ping_Scheduler *scheduler);
+
+/**
+ * Stops the scheduler after the current fire group has completed.
+ */
+void ping_schedulerStop(Ping_Scheduler *scheduler);
+
+#endif /* PING_INCLUDE_PING_PING_SCHEDULER_H_ */
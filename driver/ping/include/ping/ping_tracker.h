@@ -0,0 +1,93 @@
+/*
+* ping_tracker.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PING_INCLUDE_PING_PING_TRACKER_H_
+#define PING_INCLUDE_PING_PING_TRACKER_H_
+
+#include "ping/ping.h"
+
+#define PING_TRACKER_SHIFT 8 // fractional bits of alpha, beta, distance and velocity
+#define PING_TRACKER_ONE (1 << PING_TRACKER_SHIFT)
+#define PING_TRACKER_OVERHEAD 1000 // us from the start of a ping to the start of the echo, and some
+
+struct Ping_Tracker {
+  // 'private' data, don't change anything in here
+  int32_t distance;  // 1/10 mm, PING_TRACKER_SHIFT fixed point
+  int32_t velocity;  // 1/10 mm/s, PING_TRACKER_SHIFT fixed point
+  uint32_t lastTime; // system_get_time() of the last measurement
+  uint16_t alpha;    // PING_TRACKER_SHIFT fixed point, 0 to PING_TRACKER_ONE
+  uint16_t beta;
+  uint32_t window;   // 1/10 mm, how far from the prediction an echo is searched for
+  uint8_t maxMisses; // the track is lost after this many missed samples in a row
+  uint8_t misses;
+  uint8_t samples;   // measurements since the track was (re)started, saturates at 2
+  uint32_t lost;     // number of times the track has been lost
+};
+
+/**
+ * Initiates the tracker and attaches it to the sensor, it will be fed with every result of the sensor.
+ * alpha and beta are the distance and velocity gains, in 1/PING_TRACKER_ONE units.
+ * 'window' (1/10 mm) is how far from the predicted distance the next echo is searched for,
+ * use 0 to never narrow the time out of the pings.
+ */
+void ping_trackerInit(Ping_Tracker *tracker, Ping_Data *pingData, uint16_t alpha, uint16_t beta,
+    uint32_t window, uint8_t maxMisses);
+
+/**
+ * Detaches the tracker from the sensor.
+ */
+void ping_trackerDetach(Ping_Data *pingData);
+
+/**
+ * Feeds a measurement taken at 'timeStamp' (system_get_time()) into the tracker.
+ * Failed measurements just advance the prediction, until maxMisses is reached.
+ * This is done automatically for attached sensors.
+ */
+void ping_trackerUpdate(Ping_Tracker *tracker, Ping_Data *pingData, bool success, uint32_t echoTime, uint32_t timeStamp);
+
+/**
+ * Returns false if there is no track, otherwise the smoothed distance (1/10 mm) and
+ * velocity (1/10 mm/s, positive is moving away) of the last measurement.
+ */
+bool ping_trackerGet(Ping_Tracker *tracker, int32_t *distance, int32_t *velocity);
+
+/**
+ * Returns false if there is no track, otherwise the predicted distance (1/10 mm) at 'timeStamp'.
+ */
+bool ping_trackerPredict(Ping_Tracker *tracker, uint32_t timeStamp, int32_t *distance);
+
+/**
+ * Returns the time out (us) of a ping started at 'timeStamp': the echo time of the
+ * predicted distance plus the search window, never more than 'maxPeriod'.
+ */
+uint32_t ping_trackerTimeout(Ping_Tracker *tracker, Ping_Data *pingData, uint32_t timeStamp, uint32_t maxPeriod);
+
+#endif /* PING_INCLUDE_PING_PING_TRACKER_H_ */
@@ -29,174 +29,1422 @@
 * POSSIBILITY OF SUCH DAMAGE.
 */
 #include "ping/ping.h"
+#include "ping/ping_tracker.h"
+#include "ping/ping_log.h"
 #include "osapi.h"
 #include "ets_sys.h"
 #include "gpio.h"
 #include "mem.h"
 #include "easygpio/easygpio.h"
 #include "os_type.h"
+#include "user_interface.h"
 
 #define PING_TRIGGER_DEFAULT_STATE 0
 #define PING_TRIGGER_LENGTH 10 //  // Wait long enough for the sensor to realize the trigger pin is high. Sensor specs say to wait 10uS.
 #define PING_POLL_PERIOD 100 // 100 us, used when polling interrupt results
+#define PING_MIN_ECHO_TIME 50 // 50 us, anything shorter than this is probably a previous echo
+#define PING_SETTLE_TIME 50 // 50 us, single pin mode: time to hold the trigger pin low before listening
+#define PING_WAKEUP_LENGTH 50 // 50 us, length of each half of the first wake up pulse, doubled for every retry
+#define PING_WAKEUP_WAIT 500 // 500 us, first wait for a woken up sensor to let go of the echo pin, doubled for every retry
+#define PING_WAKEUP_ATTEMPTS 4 // wake up pulses before giving up on a stuck echo pin
+#define PING_BURST_MIN_GUARD 500 // 500 us, shortest wait between the end of an echo and the next trigger pulse of a burst
+#define PING_BURST_MARGIN 100 // 100 us, extra wait for the second bounce, covers the interrupt latency in the measured times
 
-static volatile uint32_t   ping_timeStamp0 = 0;
-static volatile bool       ping_echoStarted = false;
-static volatile uint32_t   ping_timeStamp1 = 0;
-static volatile bool       ping_echoEnded = false;
-static volatile int8_t     ping_currentEchoPin = -1;
-static volatile uint32_t   ping_allEchoPins = 0; // a mask containing all of the initiated interrupt pins
+// adaptive time out, see ping_setAdaptiveTimeout()
+#define PING_ADAPTIVE_BLOCK 16 // successful pings per history block
+#define PING_ADAPTIVE_PROBE_INTERVAL 16 // every 16th ping uses the full time out
+#define PING_ADAPTIVE_MARGIN 1000 // 1000 us (~17 cm), plus 1/4 of the longest echo
+
+#ifndef PING_TASK_PRIO
+#define PING_TASK_PRIO 1 // USER_TASK_PRIO_1, define PING_TASK_PRIO in user_config.h if you need this priority for something else
+#endif
+#define PING_TASK_QUEUE_LEN 4
+
+#define PING_MAX_ECHO_PINS 16 // GPIO0-15, GPIO16 has no interrupt
+#ifndef PING_EVENT_RING_SIZE
+#define PING_EVENT_RING_SIZE 32 // must be a power of two, at least twice the number of pings in flight at once
+#endif
+
+#define PING_EDGE_RISING 1
+#define PING_EDGE_FALLING 0
+
+// FRC1 runs at APB_CLK_FREQ/16 = 5MHz
+#define PING_FRC1_DIVIDED_BY_16 4
+#define PING_FRC1_TICKS_PER_US 5
+#define PING_FRC1_MIN_PERIOD 10 // us
+#define PING_FRC1_MAX_PERIOD (0x7fffff/PING_FRC1_TICKS_PER_US) // the counter is 23 bits
+
+#ifdef PING_CCOUNT_TIMESTAMPS
+// Time stamp the echo edges with the CPU cycle counter: 12.5ns (80MHz) or 6.25ns (160MHz) resolution
+#define PING_TICKS() ping_getCycleCount()
+#else
+// Time stamp the echo edges with system_get_time(): 1us resolution
+#define PING_TICKS() system_get_time()
+#endif
+
+#define PING_LOCK() do { ETS_GPIO_INTR_DISABLE(); ETS_FRC1_INTR_DISABLE(); } while (0)
+#define PING_UNLOCK() do { ETS_FRC1_INTR_ENABLE(); ETS_GPIO_INTR_ENABLE(); } while (0)
+
+/**
+ * An echo edge, as seen by the interrupt handler
+ */
+typedef struct {
+  uint32_t timeStamp;
+  uint8_t pin;
+  uint8_t edge;
+} Ping_Event;
+
+/**
+ * Single producer (the interrupt handlers), single consumer (task context) ring
+ * buffer. The producer only writes 'head', the consumer only writes 'tail'.
+ * The GPIO and the FRC1 handlers run on the same interrupt level, so they never
+ * push at the same time.
+ */
+static struct {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t overflows;
+  volatile Ping_Event events[PING_EVENT_RING_SIZE];
+} ping_eventRing;
+
+typedef enum {
+  PING_PHASE_IDLE = 0,
+  PING_PHASE_GUARD,      // burst: waiting for the reverberation of the previous echo to die out
+  PING_PHASE_WAIT_LOW,   // the falling edge interrupt is armed, waiting for a previous echo to end
+  PING_PHASE_TRIGGER,    // the trigger pin is high
+  PING_PHASE_SETTLE,     // single pin mode: holding the trigger pin low
+  PING_PHASE_LISTEN,     // the echo interrupt is armed, the deadline is the time out
+  PING_PHASE_WAKE_LOW,   // first half of a wake up pulse
+  PING_PHASE_WAKE_HIGH,  // second half of a wake up pulse
+  PING_PHASE_WAKE_WAIT   // the falling edge interrupt is armed, waiting for the woken up sensor
+} Ping_Phase;
+
+/**
+ * The part of a ping that is driven by the FRC1 interrupt handler, indexed by echo pin.
+ */
+typedef struct {
+  volatile uint32_t deadline; // when the FRC1 handler should look at this channel again
+  uint32_t timeOutAt;
+  uint32_t triggeredAt; // system_get_time() when the trigger pin was raised
+  int8_t triggerPin;
+  volatile uint8_t phase;
+  uint8_t wakeAttempt; // the wake up pulses sent so far, each one twice as long as the one before
+} Ping_Channel;
+
+/**
+ * Everything the echo interrupt handler reads and writes, other than the event ring.
+ * Every field is a 32 bit word, so each access is a single load or store.
+ */
+typedef struct {
+  volatile uint32_t armedPins;     // a mask containing the echo pins waiting for an echo edge
+  volatile uint32_t highPins;      // a mask containing the echo pins where the echo has started
+  volatile uint32_t idlePins;      // a mask containing the echo pins waiting for the pin to go low
+  volatile uint32_t scheduledPins; // a mask containing the channels with a deadline
+  volatile uint32_t drainIsPosted;
+  volatile uint32_t isrCount;      // echo interrupt handler calls
+  volatile uint32_t isrCycles;     // CPU cycles spent in them
+  uint32_t pinConfig[PING_MAX_ECHO_PINS]; // the GPIO_PINn register of each echo pin, with the interrupt disabled
+  volatile uint32_t spuriousInterrupts[PING_MAX_ECHO_PINS]; // edges on echo pins that were not armed
+} Ping_Capture;
+
+static Ping_Capture        ping_capture __attribute__((aligned(4)));
+static Ping_Channel        ping_channels[PING_MAX_ECHO_PINS];
+static Ping_Data *         ping_slots[PING_MAX_ECHO_PINS]; // the ping currently using each echo pin, indexed by GPIO number
+static volatile uint32_t   ping_timedOutPins = 0; // a mask containing the channels that have timed out
+static volatile uint32_t   ping_stuckHighPins = 0; // the timed out channels where the echo pin never went low
+static volatile uint32_t   ping_allEchoPins = 0; // a mask containing all of the initiated echo pins
+static volatile bool       ping_inTimerHandler = false;
+static volatile Ping_BusyStats ping_busyStats;
+static volatile uint32_t   ping_timerIsrCycles = 0; // CPU cycles spent in the FRC1 interrupt handler
+
+#ifdef PING_LATENCY_STATS
+static volatile Ping_LatencyHistogram ping_latency[PING_MAX_ECHO_PINS];
+static volatile uint32_t ping_latencyProbeAt[PING_MAX_ECHO_PINS]; // PING_TICKS() when each probe was raised
+static volatile uint32_t ping_latencyProbePins = 0; // a mask containing the pins with a probe in flight
+static volatile uint8_t  ping_latencyTicksPerUs = 1;
+#endif
+
+static bool ping_taskIsInitiated = false;
+static os_event_t ping_taskQueue[PING_TASK_QUEUE_LEN];
 
 // forward declarations
+static inline uint32_t ping_getCycleCount(void);
 static void ping_disableInterrupt(int8_t pin);
-static void ping_intr_handler(void *key);
+static void ping_intr_handler(void *arg);
+static void ping_timer_intr_handler(void *arg);
+static void ping_task(os_event_t *event);
+static void ping_burstCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg);
+
 
+/**
+ * Reads the CCOUNT register, it wraps around every 2^32 CPU cycles.
+ */
+static inline uint32_t
+ping_getCycleCount(void) {
+#ifdef PING_HOST_SIM
+  return sim_getCycleCount(); // the host build, see host/sim.c
+#else
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0,ccount":"=a" (ccount));
+  return ccount;
+#endif
+}
+
+/**
+ * Returns the number of PING_TICKS() per microsecond.
+ */
+static uint8_t ICACHE_FLASH_ATTR
+ping_ticksPerUs(void) {
+#ifdef PING_CCOUNT_TIMESTAMPS
+  return system_get_cpu_freq();
+#else
+  return 1;
+#endif
+}
 
+/**
+ * Converts a number of PING_TICKS() into nanoseconds.
+ */
+static uint32_t ICACHE_FLASH_ATTR
+ping_ticksToNs(uint32_t ticks, uint8_t ticksPerUs) {
+  switch (ticksPerUs) {
+    case 1:
+      return ticks*1000;
+    case 80:
+      return (ticks*25) >> 1;  // 12.5 ns per cycle
+    case 160:
+      return (ticks*25) >> 2;  // 6.25 ns per cycle
+    default:
+      return (uint32_t)(((uint64_t) ticks*1000)/ticksPerUs);
+  }
+}
+
+/**
+ * Disables the interrupt of an echo pin, by writing its GPIO_PINn register directly.
+ */
 static void
 ping_disableInterrupt(int8_t pin) {
-  if (pin>0){
-    gpio_pin_intr_state_set(GPIO_ID_PIN(pin), GPIO_PIN_INTR_DISABLE);
+  if (pin>=0){
+    GPIO_REG_WRITE(GPIO_PIN_ADDR(pin), ping_capture.pinConfig[pin]);
   }
 }
 
+#ifdef PING_LATENCY_STATS
+/**
+ * Adds a latency (in PING_TICKS()) to a log2 histogram, called from the interrupt handlers only.
+ */
 static void
-ping_intr_handler(void *key) {
-  uint32_t gpio_status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
-  if (ping_allEchoPins & gpio_status) {
-    if (ping_currentEchoPin>=0 && (gpio_status & BIT(ping_currentEchoPin))) {
-      // This interrupt was intended for us - clear interrupt status
-      GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, gpio_status & BIT(ping_currentEchoPin));
-
-      if(!ping_echoStarted) {
-        gpio_pin_intr_state_set(GPIO_ID_PIN(ping_currentEchoPin), GPIO_PIN_INTR_NEGEDGE);
-        ping_timeStamp0 = system_get_time();
-        ping_echoStarted = true;
+ping_latencyAdd(volatile uint32_t *buckets, uint32_t latency) {
+  uint8_t bucket = 0;
+  while (latency >>= 1) {
+    bucket++;
+  }
+  buckets[bucket < PING_LATENCY_BUCKETS ? bucket : PING_LATENCY_BUCKETS-1]++;
+}
+#endif
+
+/**
+ * Asks the ping task to drain the event ring, called from the interrupt handlers.
+ */
+static void
+ping_postDrain(void) {
+  if (!ping_capture.drainIsPosted) {
+    ping_capture.drainIsPosted = true;
+    system_os_post(PING_TASK_PRIO, 0, 0);
+  }
+}
+
+/**
+ * Adds an event to the ring, called from the interrupt handlers only.
+ * The event is dropped (and counted) if the ring is full.
+ */
+static bool
+ping_pushEvent(uint8_t pin, uint8_t edge, uint32_t timeStamp) {
+  uint32_t head = ping_eventRing.head;
+  volatile Ping_Event *event;
+
+  if (head - ping_eventRing.tail >= PING_EVENT_RING_SIZE) {
+    ping_eventRing.overflows++;
+    return false;
+  }
+  event = &ping_eventRing.events[head & (PING_EVENT_RING_SIZE-1)];
+  event->timeStamp = timeStamp;
+  event->pin = pin;
+  event->edge = edge;
+  // publish the event after it has been written
+  ping_eventRing.head = head + 1;
+  return true;
+}
+
+/**
+ * Removes the oldest event from the ring, called from task context only.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_popEvent(Ping_Event *event) {
+  uint32_t tail = ping_eventRing.tail;
+  volatile Ping_Event *slot;
+
+  if (tail == ping_eventRing.head) {
+    return false;
+  }
+  slot = &ping_eventRing.events[tail & (PING_EVENT_RING_SIZE-1)];
+  event->timeStamp = slot->timeStamp;
+  event->pin = slot->pin;
+  event->edge = slot->edge;
+  ping_eventRing.tail = tail + 1;
+  return true;
+}
+
+/**
+ * Loads FRC1 with the time left to the earliest deadline.
+ * Must be called with the FRC1 interrupt disabled, or from an interrupt handler.
+ */
+static void
+ping_timerRearm(uint32_t now) {
+  uint32_t pending = ping_capture.scheduledPins;
+  uint32_t earliest = PING_FRC1_MAX_PERIOD;
+  uint8_t pin = 0;
+
+  if (!pending) {
+    return;
+  }
+  for (pin=0; pending; pin++, pending>>=1) {
+    if (pending & 1) {
+      int32_t left = (int32_t)(ping_channels[pin].deadline - now);
+      if (left < (int32_t)earliest) {
+        earliest = left < PING_FRC1_MIN_PERIOD ? PING_FRC1_MIN_PERIOD : left;
+      }
+    }
+  }
+  RTC_REG_WRITE(FRC1_LOAD_ADDRESS, earliest * PING_FRC1_TICKS_PER_US);
+}
+
+/**
+ * Makes the FRC1 handler look at the channel of 'pin' at time 'at'.
+ * Must be called with PING_LOCK() held, or from an interrupt handler.
+ */
+static void
+ping_timerSchedule(uint8_t pin, uint32_t at) {
+  ping_channels[pin].deadline = at;
+  ping_capture.scheduledPins |= BIT(pin);
+  if (!ping_inTimerHandler) {
+    // the FRC1 handler rearms the timer itself when it is done
+    ping_timerRearm(system_get_time());
+  }
+}
+
+/**
+ * Arms the echo interrupt and waits for the echo (or the time out).
+ */
+static void
+ping_armEcho(uint8_t pin) {
+  Ping_Channel *channel = &ping_channels[pin];
+  GPIO_DIS_OUTPUT(pin);
+  ping_capture.highPins &= ~BIT(pin);
+  ping_capture.armedPins |= BIT(pin);
+  // both edges, the interrupt handler tells them apart by the level of the pin
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(pin), ping_capture.pinConfig[pin] | GPIO_PIN_INT_TYPE_SET(GPIO_PIN_INTR_ANYEDGE));
+  channel->phase = PING_PHASE_LISTEN;
+  ping_timerSchedule(pin, channel->timeOutAt);
+}
+
+/**
+ * Ends the channel of 'pin' without an echo, the ping task picks it up from ping_timedOutPins.
+ */
+static void
+ping_timeOut(uint8_t pin) {
+  ping_disableInterrupt(pin);
+  ping_capture.armedPins &= ~BIT(pin);
+  ping_capture.highPins &= ~BIT(pin);
+  ping_channels[pin].phase = PING_PHASE_IDLE;
+  ping_timedOutPins |= BIT(pin);
+  ping_postDrain();
+}
+
+/**
+ * Arms the falling edge interrupt of an echo pin that is still high. Returns false, with the
+ * interrupt left disabled, if the pin is low already.
+ * Must be called with PING_LOCK() held, or from an interrupt handler.
+ */
+static bool
+ping_waitIdle(uint8_t pin) {
+  uint32_t pinBit = BIT(pin);
+
+  if (!(GPIO_REG_READ(GPIO_IN_ADDRESS) & pinBit)) {
+    return false;
+  }
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(pin), ping_capture.pinConfig[pin] | GPIO_PIN_INT_TYPE_SET(GPIO_PIN_INTR_NEGEDGE));
+  // armed first, checked again after: an edge in between is latched, not lost
+  if (GPIO_REG_READ(GPIO_IN_ADDRESS) & pinBit) {
+    ping_capture.idlePins |= pinBit;
+    return true;
+  }
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(pin), ping_capture.pinConfig[pin]);
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, pinBit);
+  return false;
+}
+
+/**
+ * Disarms the falling edge interrupt of ping_waitIdle().
+ */
+static void
+ping_stopWaitIdle(uint8_t pin) {
+  ping_disableInterrupt(pin);
+  ping_capture.idlePins &= ~BIT(pin);
+}
+
+/**
+ * Raises the trigger pin, the echo pin is low.
+ */
+static void
+ping_trigger(uint8_t pin, uint32_t now) {
+  Ping_Channel *channel = &ping_channels[pin];
+  GPIO_OUTPUT_SET(channel->triggerPin, 1);
+  channel->triggeredAt = now;
+  channel->phase = PING_PHASE_TRIGGER;
+  ping_timerSchedule(pin, now + PING_TRIGGER_LENGTH);
+}
+
+/**
+ * Starts the next wake up pulse on a stuck echo pin, or gives up on it.
+ */
+static void
+ping_wakeUp(uint8_t pin, uint32_t now) {
+  Ping_Channel *channel = &ping_channels[pin];
+
+  if (channel->wakeAttempt >= PING_WAKEUP_ATTEMPTS) {
+    ping_stuckHighPins |= BIT(pin);
+    ping_timeOut(pin);
+    return;
+  }
+  GPIO_OUTPUT_SET(channel->triggerPin, PING_TRIGGER_DEFAULT_STATE);
+  channel->phase = PING_PHASE_WAKE_LOW;
+  ping_timerSchedule(pin, now + (PING_WAKEUP_LENGTH << channel->wakeAttempt));
+}
+
+/**
+ * The echo pin went low while the channel was waiting for it, called from the GPIO handler.
+ */
+static void
+ping_lineIdle(uint8_t pin) {
+  Ping_Channel *channel = &ping_channels[pin];
+
+  ping_stopWaitIdle(pin);
+  ping_capture.scheduledPins &= ~BIT(pin);
+  if (PING_PHASE_WAIT_LOW == channel->phase) {
+    ping_trigger(pin, system_get_time());
+  } else {
+    // the woken up sensor is back, this ping is lost but the next one starts on time
+    ping_stuckHighPins |= BIT(pin);
+    ping_timeOut(pin);
+  }
+}
+
+/**
+ * Advances the channel of 'pin' one step, called from the FRC1 handler when its deadline has passed.
+ */
+static void
+ping_channelExpired(uint8_t pin, uint32_t now) {
+  Ping_Channel *channel = &ping_channels[pin];
+
+  switch (channel->phase) {
+    case PING_PHASE_GUARD:
+      if (ping_waitIdle(pin)) {
+        channel->phase = PING_PHASE_WAIT_LOW;
+        ping_timerSchedule(pin, channel->timeOutAt);
       } else {
-        ping_timeStamp1 = system_get_time();
-        ping_echoEnded = true;
-        ping_disableInterrupt(ping_currentEchoPin);
-        ping_currentEchoPin = -1;
+        ping_trigger(pin, now);
       }
+      break;
+    case PING_PHASE_WAIT_LOW:
+      // echo pin never went low before the time out, something is wrong.
+      // turns out this happens whenever the sensor doesn't receive any echo at all.
+      // Wake up a sleeping device
+      ping_stopWaitIdle(pin);
+      channel->wakeAttempt = 0;
+      ping_wakeUp(pin, now);
+      break;
+    case PING_PHASE_TRIGGER:
+      GPIO_OUTPUT_SET(channel->triggerPin, 0);
+      if (channel->triggerPin == pin) {
+        // force the trigger pin low for 50us. This helps stabilise echo pin when
+        // running in single pin mode.
+        channel->phase = PING_PHASE_SETTLE;
+        ping_timerSchedule(pin, now + PING_SETTLE_TIME);
+      } else {
+        ping_armEcho(pin);
+      }
+      break;
+    case PING_PHASE_SETTLE:
+      ping_armEcho(pin);
+      break;
+    case PING_PHASE_LISTEN:
+      ping_timeOut(pin);
+      break;
+    case PING_PHASE_WAKE_LOW:
+      GPIO_OUTPUT_SET(channel->triggerPin, !PING_TRIGGER_DEFAULT_STATE);
+      channel->phase = PING_PHASE_WAKE_HIGH;
+      ping_timerSchedule(pin, now + (PING_WAKEUP_LENGTH << channel->wakeAttempt));
+      break;
+    case PING_PHASE_WAKE_HIGH:
+      GPIO_OUTPUT_SET(channel->triggerPin, PING_TRIGGER_DEFAULT_STATE);
+      if (channel->triggerPin == pin) {
+        // single pin mode: listen to the sensor, not to our own output
+        GPIO_DIS_OUTPUT(pin);
+      }
+      if (ping_waitIdle(pin)) {
+        channel->phase = PING_PHASE_WAKE_WAIT;
+        ping_timerSchedule(pin, now + (PING_WAKEUP_WAIT << channel->wakeAttempt));
+      } else {
+        ping_stuckHighPins |= BIT(pin);
+        ping_timeOut(pin);
+      }
+      channel->wakeAttempt++;
+      break;
+    case PING_PHASE_WAKE_WAIT:
+      // still stuck, try again with a longer pulse
+      ping_stopWaitIdle(pin);
+      ping_wakeUp(pin, now);
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+ping_timer_intr_handler(void *arg) {
+  uint32_t entry = ping_getCycleCount();
+  uint32_t now = system_get_time();
+  uint32_t pending = ping_capture.scheduledPins;
+  uint8_t pin = 0;
+
+  RTC_CLR_REG_MASK(FRC1_INT_ADDRESS, FRC1_INT_CLR_MASK);
+  ping_inTimerHandler = true;
+  for (pin=0; pending; pin++, pending>>=1) {
+    if ((pending & 1) && (int32_t)(ping_channels[pin].deadline - now) <= 0) {
+      ping_capture.scheduledPins &= ~BIT(pin);
+#ifdef PING_LATENCY_STATS
+      ping_latencyAdd(ping_latency[pin].timer, (now - ping_channels[pin].deadline) * ping_latencyTicksPerUs);
+#endif
+      ping_channelExpired(pin, now);
+    }
+  }
+  ping_inTimerHandler = false;
+  ping_timerRearm(now);
+
+  ping_busyStats.isrCount++;
+  ping_timerIsrCycles += ping_getCycleCount() - entry;
+}
+
+/**
+ * The GPIO interrupt handler of one echo pin, called by the easygpio dispatcher with the
+ * pin number. The dispatcher has already cleared the interrupt status.
+ * The interrupt fires on both edges and the level of the pin tells which one it was,
+ * so the interrupt type is only written again when the echo has ended.
+ */
+static void
+ping_intr_handler(void *arg) {
+  uint32_t now = PING_TICKS(); // as early as possible
+  uint32_t entry = ping_getCycleCount();
+  uint32_t pin = (uint32_t)(size_t)arg;
+  uint32_t pinBit = BIT(pin);
+  uint32_t isHigh = GPIO_REG_READ(GPIO_IN_ADDRESS) & pinBit;
+  uint8_t edge = PING_EDGE_RISING;
+
+#ifdef PING_LATENCY_STATS
+  if (ping_latencyProbePins & pinBit) {
+    ping_latencyProbePins &= ~pinBit;
+    ping_latencyAdd(ping_latency[pin].gpio, now - ping_latencyProbeAt[pin]);
+    return;
+  }
+#endif
+  if (!(ping_capture.armedPins & pinBit)) {
+    if ((ping_capture.idlePins & pinBit) && !isHigh) {
+      ping_lineIdle(pin);
     } else {
-      // This interrupt was intended for us, but not at this moment - clear interrupt status anyway
-      GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, gpio_status & ping_allEchoPins);
+      // intended for us, but not at this moment
+      ping_capture.spuriousInterrupts[pin]++;
     }
+    return;
   }
+  if (isHigh && !(ping_capture.highPins & pinBit)) {
+    ping_capture.highPins |= pinBit;
+  } else if (!isHigh && (ping_capture.highPins & pinBit)) {
+    GPIO_REG_WRITE(GPIO_PIN_ADDR(pin), ping_capture.pinConfig[pin]);
+    ping_capture.armedPins &= ~pinBit;
+    ping_capture.highPins &= ~pinBit;
+    // the time out is no longer needed, the FRC1 handler won't look at the channel again
+    ping_capture.scheduledPins &= ~pinBit;
+    edge = PING_EDGE_FALLING;
+  } else {
+    // the pin is back at the level it had, a pulse shorter than the interrupt latency
+    ping_capture.spuriousInterrupts[pin]++;
+    return;
+  }
+  if (ping_pushEvent(pin, edge, now)) {
+    ping_postDrain();
+  } else {
+    // the ring is full and the edge is lost, end the ping instead of leaving it
+    // waiting for an edge that will never be processed
+    ping_capture.scheduledPins &= ~pinBit;
+    ping_timeOut(pin);
+  }
+
+  ping_capture.isrCount++;
+  ping_capture.isrCycles += ping_getCycleCount() - entry;
 }
 
 /**
- * Sends a ping, and returns the number of microseconds it took to receive a response.
- * Will give up after maxPeriod (with false as return value)
+ * Reserves the echo pin of pingData. Returns false if another ping is using it.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_claimSlot(Ping_Data *pingData, bool isAsync) {
+  if (NULL != ping_slots[pingData->echoPin] || PING_STATE_IDLE != pingData->state) {
+    return false;
+  }
+  ping_slots[pingData->echoPin] = pingData;
+  pingData->isAsync = isAsync;
+  pingData->success = false;
+  return true;
+}
+
+static void ICACHE_FLASH_ATTR
+ping_resetStats(Ping_Data *pingData) {
+  os_memset(&pingData->stats, 0, sizeof(Ping_Stats));
+  pingData->stats.minEchoTime = 0xFFFFFFFF;
+}
+
+/**
+ * A ping that could not start because the echo pin was taken, by another Ping_Data or
+ * by a ping of its own that is still running.
+ */
+static void ICACHE_FLASH_ATTR
+ping_recordBusy(Ping_Data *pingData) {
+  pingData->status = PING_STATUS_BUSY;
+  pingData->stats.outcomes[PING_STATUS_BUSY]++;
+}
+
+/**
+ * Returns the time out to use for a ping, given the one asked for.
+ * Call it before PING_LOCK(), the tracker prediction is 64 bit math.
+ */
+static uint32_t ICACHE_FLASH_ATTR
+ping_effectiveTimeout(Ping_Data *pingData, uint32_t maxPeriod) {
+  uint32_t timeout = maxPeriod;
+  uint32_t longest = 0;
+
+  if (pingData->isAdaptive && pingData->adaptiveProbe < PING_ADAPTIVE_PROBE_INTERVAL &&
+      (pingData->adaptiveMax[1] || pingData->adaptiveCount >= (PING_ADAPTIVE_BLOCK >> 1))) {
+    longest = pingData->adaptiveMax[0] > pingData->adaptiveMax[1] ? pingData->adaptiveMax[0] : pingData->adaptiveMax[1];
+    timeout = longest + (longest >> 2) + PING_ADAPTIVE_MARGIN;
+  }
+  if (pingData->tracker) {
+    timeout = ping_trackerTimeout(pingData->tracker, pingData, system_get_time(), timeout);
+  }
+  return timeout < maxPeriod ? timeout : maxPeriod;
+}
+
+/**
+ * Feeds the result of a ping to the statistics, the tracker and the adaptive time out history.
+ */
+static void ICACHE_FLASH_ATTR
+ping_recordResult(Ping_Data *pingData, Ping_Status status, uint32_t echoTime) {
+  bool success = PING_STATUS_OK == status;
+
+  pingData->status = status;
+  pingData->stats.outcomes[status]++;
+  if (success) {
+    if (echoTime < pingData->stats.minEchoTime) {
+      pingData->stats.minEchoTime = echoTime;
+    }
+    if (echoTime > pingData->stats.maxEchoTime) {
+      pingData->stats.maxEchoTime = echoTime;
+    }
+    pingData->stats.sumEchoTime += echoTime;
+  }
+  if (pingData->tracker) {
+    ping_trackerUpdate(pingData->tracker, pingData, success, echoTime, pingData->startTime);
+  }
+  if (!pingData->isAdaptive) {
+    return;
+  }
+  if (pingData->timeout < pingData->maxPeriod) {
+    pingData->adaptiveProbe++;
+    if (!success) {
+      pingData->shortenedTimeouts++;
+      pingData->savedTime += pingData->maxPeriod - pingData->timeout;
+      // maybe the target moved out of the window, probe the full range next time
+      pingData->adaptiveProbe = PING_ADAPTIVE_PROBE_INTERVAL;
+    }
+  } else {
+    pingData->adaptiveProbe = 0;
+  }
+  if (success) {
+    if (echoTime > pingData->adaptiveMax[0]) {
+      pingData->adaptiveMax[0] = echoTime;
+    }
+    if (++pingData->adaptiveCount >= PING_ADAPTIVE_BLOCK) {
+      pingData->adaptiveMax[1] = pingData->adaptiveMax[0];
+      pingData->adaptiveMax[0] = 0;
+      pingData->adaptiveCount = 0;
+    }
+  }
+}
+
+/**
+ * Ends a ping. Async pings are delivered to the user callback at once,
+ * blocking pings are left in the PING_STATE_DONE state for ping_pingUs() to pick up.
+ * The channel must be idle (the FRC1 and the GPIO handlers are done with it).
+ */
+static void ICACHE_FLASH_ATTR
+ping_finish(Ping_Data *pingData, Ping_Status status) {
+  uint32_t echoTime = 0;
+
+  ping_slots[pingData->echoPin] = NULL;
+  pingData->success = PING_STATUS_OK == status;
+  pingData->status = status;
+  if (!pingData->isAsync) {
+    pingData->state = PING_STATE_DONE;
+    return;
+  }
+
+  ping_busyStats.pings++;
+  ping_busyStats.waitTime += system_get_time() - pingData->startTime;
+  if (PING_STATUS_OK == status) {
+    // unsigned subtraction, a clock wrap in the middle of the echo is fine
+    echoTime = (pingData->timeStamp1 - pingData->timeStamp0) / pingData->ticksPerUs;
+    if (echoTime < PING_MIN_ECHO_TIME) {
+      // probably a previous echo - false result
+      status = PING_STATUS_TOO_SHORT;
+    }
+  }
+  pingData->state = PING_STATE_IDLE;
+  ping_recordResult(pingData, status, echoTime);
+  if (pingData->callback) {
+    pingData->callback(pingData, PING_STATUS_OK == status, echoTime, pingData->callbackArg);
+  }
+}
+
+/**
+ * Processes the echo edges and the time outs recorded by the interrupt handlers.
+ */
+static void ICACHE_FLASH_ATTR
+ping_drainEvents(void) {
+  Ping_Event event;
+  uint32_t timedOut = 0;
+  uint32_t stuckHigh = 0;
+  uint8_t pin = 0;
+
+  // The time outs are kept outside of the ring so that they can't get lost. A channel
+  // that has timed out can't produce any more edges, so once the ring is drained the
+  // time outs can be handled without leaving stale edges behind.
+  PING_LOCK();
+  timedOut = ping_timedOutPins;
+  stuckHigh = ping_stuckHighPins;
+  ping_timedOutPins = 0;
+  ping_stuckHighPins = 0;
+  PING_UNLOCK();
+
+  while (ping_popEvent(&event)) {
+    Ping_Data *pingData = ping_slots[event.pin];
+    if (NULL == pingData) {
+      // the ping has already timed out
+      continue;
+    }
+    if (PING_EDGE_RISING == event.edge && PING_STATE_WAIT_ECHO == pingData->state) {
+      pingData->timeStamp0 = event.timeStamp;
+      pingData->state = PING_STATE_ECHO;
+    } else if (PING_EDGE_FALLING == event.edge && PING_STATE_ECHO == pingData->state) {
+      pingData->timeStamp1 = event.timeStamp;
+      ping_finish(pingData, PING_STATUS_OK);
+    }
+  }
+
+  // an echo that started before the time out still counts as a failure
+  for (pin=0; timedOut; pin++, timedOut>>=1, stuckHigh>>=1) {
+    Ping_Data *pingData = ping_slots[pin];
+    if ((timedOut & 1) && NULL != pingData) {
+      if (stuckHigh & 1) {
+        ping_finish(pingData, PING_STATUS_STUCK_HIGH);
+      } else if (PING_STATE_ECHO == pingData->state) {
+        ping_finish(pingData, PING_STATUS_ECHO_TOO_LONG);
+      } else {
+        ping_finish(pingData, PING_STATUS_NO_ECHO);
+      }
+    }
+  }
+}
+
+/**
+ * Drains the event ring, posted by the interrupt handlers.
+ */
+static void ICACHE_FLASH_ATTR
+ping_task(os_event_t *event) {
+  ping_capture.drainIsPosted = false;
+  ping_drainEvents();
+}
+
+/**
+ * Claims the echo pin of pingData and sets up the channel of a ping starting at 'startTime'.
+ * Must be called with PING_LOCK() held, 'timeout' is what ping_effectiveTimeout() returned
+ * before the lock was taken. Returns false if another ping is using the echo pin.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_claimChannel(Ping_Data *pingData, uint32_t maxPeriod, uint32_t timeout, bool isAsync, uint32_t startTime) {
+  Ping_Channel *channel = &ping_channels[pingData->echoPin];
+
+  if (!ping_claimSlot(pingData, isAsync)) {
+    return false;
+  }
+  pingData->maxPeriod = maxPeriod;
+  pingData->timeout = timeout;
+  pingData->startTime = startTime;
+  pingData->ticksPerUs = ping_ticksPerUs();
+  pingData->state = PING_STATE_WAIT_ECHO;
+  channel->triggerPin = pingData->triggerPin;
+  channel->timeOutAt = startTime + timeout;
+  return true;
+}
+
+/**
+ * Claims the echo pin of pingData and sets up the channel, the timing is then handled by the
+ * FRC1 and the GPIO interrupt handlers. Must be called with PING_LOCK() held, see ping_claimChannel().
+ * Returns true if the trigger pin should be raised now, false if the ping waits for the
+ * echo of a previous ping to end first (or couldn't be started at all, see 'started').
+ */
+static bool ICACHE_FLASH_ATTR
+ping_prepare(Ping_Data *pingData, uint32_t maxPeriod, uint32_t timeout, bool isAsync, uint32_t now, bool *started) {
+  uint8_t echoPin = pingData->echoPin;
+  Ping_Channel *channel = &ping_channels[echoPin];
+
+  *started = ping_claimChannel(pingData, maxPeriod, timeout, isAsync, now);
+  if (!*started) {
+    return false;
+  }
+  if (ping_waitIdle(echoPin)) {
+    // the echo of a previous ping is still ringing, the GPIO handler
+    // raises the trigger pin as soon as it ends
+    channel->phase = PING_PHASE_WAIT_LOW;
+    ping_timerSchedule(echoPin, channel->timeOutAt);
+    return false;
+  }
+  channel->triggeredAt = now;
+  channel->phase = PING_PHASE_TRIGGER;
+  ping_timerSchedule(echoPin, now + PING_TRIGGER_LENGTH);
+  return true;
+}
+
+/**
+ * Starts the channel of pingData. The trigger pulse, the time out and the rest of the
+ * timing is then handled by the FRC1 and the GPIO interrupt handlers.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_start(Ping_Data *pingData, uint32_t maxPeriod, bool isAsync) {
+  // the tracker and the conversion factors take a while, not something to do with the interrupts off
+  uint32_t timeout = ping_effectiveTimeout(pingData, maxPeriod);
+  bool started = false;
+
+  PING_LOCK();
+  if (ping_prepare(pingData, maxPeriod, timeout, isAsync, system_get_time(), &started)) {
+    GPIO_OUTPUT_SET(pingData->triggerPin, 1);
+  }
+  PING_UNLOCK();
+  return started;
+}
+
+/**
+ * Returns a snapshot of the CPU time spent by the asynchronous pings, optionally resets the counters.
+ */
+void ICACHE_FLASH_ATTR
+ping_getBusyStats(Ping_BusyStats *stats, bool reset) {
+  PING_LOCK();
+  stats->pings = ping_busyStats.pings;
+  stats->waitTime = ping_busyStats.waitTime;
+  stats->isrTime = (ping_timerIsrCycles + ping_capture.isrCycles) / system_get_cpu_freq();
+  stats->isrCount = ping_busyStats.isrCount + ping_capture.isrCount;
+  stats->echoIsrCount = ping_capture.isrCount;
+  stats->echoIsrCycles = ping_capture.isrCycles;
+  if (reset) {
+    os_memset((void *)&ping_busyStats, 0, sizeof(ping_busyStats));
+    ping_timerIsrCycles = 0;
+    ping_capture.isrCount = 0;
+    ping_capture.isrCycles = 0;
+  }
+  PING_UNLOCK();
+}
+
+/**
+ * Returns the number of echo edges that were lost because the event ring was full.
+ */
+uint32_t ICACHE_FLASH_ATTR
+ping_getEventOverflows(void) {
+  return ping_eventRing.overflows;
+}
+
+/**
+ * Returns true if an asynchronous ping is in progress on this sensor.
  */
 bool ICACHE_FLASH_ATTR
-ping_pingUs(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response) {
-  uint32_t timeOutAt = system_get_time() + maxPeriod;
-  ping_echoEnded = false;
-  ping_echoStarted = false;
-  ping_timeStamp0 = system_get_time();
+ping_isBusy(Ping_Data *pingData) {
+  return pingData->state != PING_STATE_IDLE;
+}
+
+/**
+ * Starts a ping and returns immediately. 'callback' will be called from the
+ * ping task when the echo has been received, or when maxPeriod microseconds have passed.
+ * Returns false if the ping could not be started (the callback will not be called).
+ */
+bool ICACHE_FLASH_ATTR
+ping_startAsync(Ping_Data *pingData, uint32_t maxPeriod, Ping_Callback callback, void *arg) {
+  if (!pingData->isInitiated) {
+    pingData->status = PING_STATUS_NOT_INITIATED;
+    PING_LOG_ERROR("ping_startAsync: Error: not initiated properly.\n");
+    return false;
+  }
+  if (!ping_start(pingData, maxPeriod, true)) {
+    ping_recordBusy(pingData);
+    PING_LOG_WARN("ping_startAsync: Error: another ping is already running.\n");
+    return false;
+  }
+  pingData->callback = callback;
+  pingData->callbackArg = arg;
+  return true;
+}
+
+/**
+ * Starts asynchronous pings on 'count' sensors at once, see ping_startAsync(). The trigger
+ * pulses of all the sensors that are ready start on the same cycle.
+ * At most PING_MAX_GROUP_SIZE sensors, the rest of 'sensors' is ignored.
+ * Returns a mask of the indexes (into 'sensors') of the pings that were started.
+ */
+uint16_t ICACHE_FLASH_ATTR
+ping_startAsyncGroup(Ping_Data *sensors[], uint8_t count, uint32_t maxPeriod, Ping_Callback callback, void *arg) {
+  uint32_t timeouts[PING_MAX_GROUP_SIZE];
+  uint32_t triggerMask = 0;
+  uint16_t startedMask = 0;
+  uint32_t now = 0;
+  bool started = false;
+  uint8_t i = 0;
+
+  if (count > PING_MAX_GROUP_SIZE) {
+    // one bit per sensor in the returned mask
+    PING_LOG_WARN("ping_startAsyncGroup: Error: %d sensors, only the first %d are started.\n", count, PING_MAX_GROUP_SIZE);
+    count = PING_MAX_GROUP_SIZE;
+  }
+  for (i=0; i<count; i++) {
+    if (sensors[i]->isInitiated) {
+      timeouts[i] = ping_effectiveTimeout(sensors[i], maxPeriod);
+    }
+  }
+  PING_LOCK();
+  now = system_get_time();
+  for (i=0; i<count; i++) {
+    Ping_Data *pingData = sensors[i];
+    if (!pingData->isInitiated) {
+      pingData->status = PING_STATUS_NOT_INITIATED;
+      continue;
+    }
+    if (ping_prepare(pingData, maxPeriod, timeouts[i], true, now, &started)) {
+      triggerMask |= BIT(pingData->triggerPin);
+    }
+    if (started) {
+      pingData->callback = callback;
+      pingData->callbackArg = arg;
+      startedMask |= BIT(i);
+    } else {
+      ping_recordBusy(pingData);
+    }
+  }
+  if (triggerMask) {
+    // single pin mode trigger pins are inputs between the pings, raise and enable in one go
+    gpio_output_set(triggerMask, 0, triggerMask, 0);
+  }
+  PING_UNLOCK();
+  return startedMask;
+}
+
+/**
+ * Sends a ping and waits for the response. The echo time is returned in PING_TICKS(),
+ * or the time it took to give up in microseconds.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_pingTicks(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response) {
+  Ping_Status status = PING_STATUS_OK;
 
   if (!pingData->isInitiated) {
     *response = 0;
-    os_printf("ping_pingUs: Error: not initiated properly.\n");
+    pingData->status = PING_STATUS_NOT_INITIATED;
+    PING_LOG_ERROR("ping_pingUs: Error: not initiated properly.\n");
     return false;
   }
-  if (ping_currentEchoPin >= 0) {
+  if (!ping_start(pingData, maxPeriod, false)) {
     // this should not really happend, how did you end up here?
     *response = 0;
-    os_printf("ping_pingUs: Error: another ping is already running.\n");
+    ping_recordBusy(pingData);
+    PING_LOG_WARN("ping_pingUs: Error: another ping is already running.\n");
     return false;
   }
 
-  uint32_t echoPin = pingData->echoPin;
-  uint32_t triggerPin = pingData->triggerPin;
-  ping_currentEchoPin = pingData->echoPin;
+  // The interrupt handlers do the timing, this is just waiting for the result.
+  // Other async pings may complete (and have their callbacks called) while we wait.
+  ping_drainEvents();
+  while (PING_STATE_DONE != pingData->state) {
+    os_delay_us(PING_POLL_PERIOD);
+    ping_drainEvents();
+  }
+  pingData->state = PING_STATE_IDLE;
 
-  while (GPIO_INPUT_GET(echoPin)) {
-    if (system_get_time() > timeOutAt) {
-      // echo pin never went low, something is wrong.
-      // turns out this happens whenever the sensor doesn't receive any echo at all.
+  status = pingData->status;
+  if (PING_STATUS_OK != status) {
+    *response = system_get_time() - pingData->startTime;
+  } else {
+    // unsigned subtraction, a clock wrap in the middle of the echo is fine
+    *response = pingData->timeStamp1 - pingData->timeStamp0;
+    if (*response < PING_MIN_ECHO_TIME * pingData->ticksPerUs) {
+      // probably a previous echo - false result
+      status = PING_STATUS_TOO_SHORT;
+    }
+  }
+  ping_recordResult(pingData, status, PING_STATUS_OK == status ? *response / pingData->ticksPerUs : 0);
+  return PING_STATUS_OK == status;
+}
 
-      //os_printf("ping_ping: Error: echo pin %d permanently high %d?.\n", echoPin, GPIO_INPUT_GET(echoPin));
-      *response = system_get_time() - ping_timeStamp0;
+/**
+ * Sends a ping, and returns the number of microseconds it took to receive a response.
+ * Will give up after maxPeriod (with false as return value)
+ */
+bool ICACHE_FLASH_ATTR
+ping_pingUs(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response) {
+  bool success = ping_pingTicks(pingData, maxPeriod, response);
+  if (success) {
+    *response /= pingData->ticksPerUs;
+  }
+  return success;
+}
 
-      // Wake up a sleeping device
-      GPIO_OUTPUT_SET(triggerPin, PING_TRIGGER_DEFAULT_STATE);
-      os_delay_us(50);
-      GPIO_OUTPUT_SET(triggerPin, !PING_TRIGGER_DEFAULT_STATE);
-      os_delay_us(50);
-      GPIO_OUTPUT_SET(triggerPin, PING_TRIGGER_DEFAULT_STATE);
-      ping_disableInterrupt(ping_currentEchoPin);
-      ping_currentEchoPin = -1;
-      return false;
+/**
+ * Sends a ping, and returns the number of nanoseconds it took to receive a response.
+ * Will give up after maxPeriod microseconds (with false as return value)
+ */
+bool ICACHE_FLASH_ATTR
+ping_pingNs(Ping_Data *pingData, uint32_t maxPeriod, uint32_t* response) {
+  bool success = ping_pingTicks(pingData, maxPeriod, response);
+  if (success) {
+    *response = ping_ticksToNs(*response, pingData->ticksPerUs);
+  }
+  return success;
+}
+
+/**
+ * Returns the outcome of the last ping of pingData.
+ */
+Ping_Status ICACHE_FLASH_ATTR
+ping_getStatus(Ping_Data *pingData) {
+  return pingData->status;
+}
+
+/**
+ * Returns a snapshot of the statistics of pingData, optionally resets the counters.
+ */
+void ICACHE_FLASH_ATTR
+ping_getStats(Ping_Data *pingData, Ping_Stats *stats, bool reset) {
+  os_memcpy(stats, &pingData->stats, sizeof(Ping_Stats));
+  if (stats->outcomes[PING_STATUS_OK]) {
+    stats->meanEchoTime = stats->sumEchoTime / stats->outcomes[PING_STATUS_OK];
+  }
+  PING_LOCK();
+  stats->spuriousInterrupts = ping_capture.spuriousInterrupts[pingData->echoPin];
+  if (reset) {
+    ping_capture.spuriousInterrupts[pingData->echoPin] = 0;
+  }
+  PING_UNLOCK();
+  if (reset) {
+    ping_resetStats(pingData);
+  }
+}
+
+#ifdef PING_LATENCY_STATS
+/**
+ * Raises the GPIO interrupt of an echo pin from software, the GPIO interrupt handler
+ * records how long it took to get there. Don't probe a pin while it is pinging.
+ */
+void ICACHE_FLASH_ATTR
+ping_latencyProbe(uint8_t pin) {
+  if (pin >= PING_MAX_ECHO_PINS || !(ping_allEchoPins & BIT(pin))) {
+    return;
+  }
+  PING_LOCK();
+  ping_latencyTicksPerUs = ping_ticksPerUs();
+  ping_latencyProbePins |= BIT(pin);
+  ping_latencyProbeAt[pin] = PING_TICKS();
+  GPIO_REG_WRITE(GPIO_STATUS_W1TS_ADDRESS, BIT(pin));
+  PING_UNLOCK(); // the interrupt fires here
+}
+
+/**
+ * Returns a snapshot of the latency histograms of an echo pin, optionally resets them.
+ */
+void ICACHE_FLASH_ATTR
+ping_getLatencyHistogram(uint8_t pin, Ping_LatencyHistogram *histogram, bool reset) {
+  if (pin >= PING_MAX_ECHO_PINS) {
+    return;
+  }
+  PING_LOCK();
+  os_memcpy(histogram, (void *)&ping_latency[pin], sizeof(Ping_LatencyHistogram));
+  histogram->ticksPerUs = ping_latencyTicksPerUs;
+  if (reset) {
+    os_memset((void *)&ping_latency[pin], 0, sizeof(Ping_LatencyHistogram));
+  }
+  PING_UNLOCK();
+}
+
+/**
+ * Prints the latency histograms of every echo pin that has any samples, one line per
+ * pin and handler, and the CPU cycles the echo interrupt handler takes per edge.
+ * tools/ping_latency.py turns the lines into something readable.
+ */
+void ICACHE_FLASH_ATTR
+ping_latencyDump(bool reset) {
+  Ping_LatencyHistogram histogram;
+  Ping_BusyStats busyStats;
+  uint8_t pin = 0;
+  uint8_t i = 0;
+  uint32_t total = 0;
+
+  for (pin=0; pin<PING_MAX_ECHO_PINS; pin++) {
+    ping_getLatencyHistogram(pin, &histogram, reset);
+    for (total=0, i=0; i<PING_LATENCY_BUCKETS; i++) {
+      total += histogram.gpio[i] + histogram.timer[i];
     }
-    os_delay_us(PING_POLL_PERIOD);
+    if (!total) {
+      continue;
+    }
+    os_printf("ping_latency pin=%d src=gpio tpu=%d", pin, histogram.ticksPerUs);
+    for (i=0; i<PING_LATENCY_BUCKETS; i++) {
+      os_printf(" %d", histogram.gpio[i]);
+    }
+    os_printf("\nping_latency pin=%d src=timer tpu=%d", pin, histogram.ticksPerUs);
+    for (i=0; i<PING_LATENCY_BUCKETS; i++) {
+      os_printf(" %d", histogram.timer[i]);
+    }
+    os_printf("\n");
+  }
+  ping_getBusyStats(&busyStats, false);
+  if (busyStats.echoIsrCount) {
+    os_printf("ping_isr src=gpio mhz=%d calls=%d cycles=%d\n", system_get_cpu_freq(),
+              busyStats.echoIsrCount, busyStats.echoIsrCycles);
+  }
+}
+#endif
+
+/**
+ * Enables or disables the adaptive time out of a sensor.
+ */
+void ICACHE_FLASH_ATTR
+ping_setAdaptiveTimeout(Ping_Data *pingData, bool enable) {
+  pingData->isAdaptive = enable;
+  pingData->adaptiveCount = 0;
+  pingData->adaptiveProbe = 0;
+  pingData->adaptiveMax[0] = 0;
+  pingData->adaptiveMax[1] = 0;
+}
+
+/**
+ * Returns the number of pings that timed out early thanks to the adaptive time out, and the
+ * time (us) that saved. Optionally resets the counters.
+ */
+void ICACHE_FLASH_ATTR
+ping_getAdaptiveStats(Ping_Data *pingData, uint32_t *shortenedTimeouts, uint32_t *savedTime, bool reset) {
+  *shortenedTimeouts = pingData->shortenedTimeouts;
+  *savedTime = pingData->savedTime;
+  if (reset) {
+    pingData->shortenedTimeouts = 0;
+    pingData->savedTime = 0;
   }
+}
 
-  GPIO_OUTPUT_SET(triggerPin, 1);
-  os_delay_us(PING_TRIGGER_LENGTH);
-  GPIO_OUTPUT_SET(triggerPin, 0);
-  
-  if (echoPin == triggerPin) {
-    // force the trigger pin low for 50us. This helps stabilise echo pin when 
-    // running in single pin mode. 
-    os_delay_us(50);
-  }
-  
-  GPIO_DIS_OUTPUT(echoPin);
-  gpio_pin_intr_state_set(GPIO_ID_PIN(echoPin), GPIO_PIN_INTR_POSEDGE);
-
-  while (!ping_echoEnded) {
-    if (system_get_time() > timeOutAt) {
-      *response = system_get_time() - ping_timeStamp0;
-      ping_disableInterrupt(ping_currentEchoPin);
-      ping_currentEchoPin = -1;
-      return false;
+/**
+ * Starts an asynchronous ping of a burst with its trigger pulse no earlier than 'startAt'
+ * (system_get_time()). The channel waits in PING_PHASE_GUARD until then, the FRC1 handler
+ * takes it from there. Returns false if the ping could not be started.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_startGuarded(Ping_Data *pingData, Ping_Burst *burst, uint32_t startAt) {
+  uint32_t timeout = ping_effectiveTimeout(pingData, burst->maxPeriod);
+  bool started = false;
+
+  PING_LOCK();
+  started = ping_claimChannel(pingData, burst->maxPeriod, timeout, true, startAt);
+  if (started) {
+    ping_channels[pingData->echoPin].phase = PING_PHASE_GUARD;
+    ping_timerSchedule(pingData->echoPin, startAt);
+  }
+  PING_UNLOCK();
+  if (!started) {
+    return false;
+  }
+  pingData->callback = ping_burstCallback;
+  pingData->callbackArg = burst;
+  return true;
+}
+
+/**
+ * The Ping_Callback of every ping of a burst: stores the result and starts the next ping,
+ * or hands the results to the user callback.
+ * The second bounce of an echo comes back twice the echo time after the burst went out.
+ * The next burst goes out as long after its trigger pulse as this one did, so the guard,
+ * counted from the falling edge, is one echo time minus the wait between the trigger pulse
+ * and the echo (plus PING_BURST_MARGIN). The time the ping task took to get here is already
+ * part of it.
+ */
+static void ICACHE_FLASH_ATTR
+ping_burstCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  Ping_Burst *burst = (Ping_Burst *)arg;
+  uint32_t now = system_get_time();
+  uint32_t guard = PING_BURST_MIN_GUARD;
+  uint32_t echoEnd = now;
+  uint32_t echoDelay;
+
+  burst->results[burst->done++] = success ? echoTime : 0;
+  if (success) {
+    burst->successes++;
+    echoEnd = now - (PING_TICKS() - pingData->timeStamp1) / pingData->ticksPerUs;
+    echoDelay = echoEnd - echoTime - ping_channels[pingData->echoPin].triggeredAt;
+    if (echoTime + PING_BURST_MARGIN > echoDelay + guard) {
+      guard = echoTime + PING_BURST_MARGIN - echoDelay;
     }
-    os_delay_us(PING_POLL_PERIOD);
+    if (guard > burst->maxPeriod) {
+      guard = burst->maxPeriod;
+    }
+  }
+  if (burst->done < burst->n) {
+    if (ping_startGuarded(pingData, burst, echoEnd + guard)) {
+      return;
+    }
+    PING_LOG_WARN("ping_burst: Error: could not start ping %d of %d.\n", burst->done + 1, burst->n);
+    while (burst->done < burst->n) {
+      burst->results[burst->done++] = 0;
+    }
+  }
+  if (burst->callback) {
+    burst->callback(pingData, burst->successes, burst->results, burst->arg);
+  }
+}
+
+/**
+ * Starts 'n' asynchronous pings back to back, as fast as the reverberation of the previous
+ * echo allows, see ping_burstCallback(). A failed ping is followed by PING_BURST_MIN_GUARD.
+ * Returns false if the first ping could not be started (the callback will not be called).
+ */
+bool ICACHE_FLASH_ATTR
+ping_burst(Ping_Burst *burst, Ping_Data *pingData, uint8_t n, uint32_t maxPeriod, uint32_t results[],
+    Ping_BurstCallback callback, void *arg) {
+  if (!n) {
+    return false;
+  }
+  burst->results = results;
+  burst->maxPeriod = maxPeriod;
+  burst->n = n;
+  burst->done = 0;
+  burst->successes = 0;
+  burst->callback = callback;
+  burst->arg = arg;
+  return ping_startAsync(pingData, maxPeriod, ping_burstCallback, burst);
+}
+
+/**
+ * Speed of sound in dry air (mm/s) at 'celsius' degrees.
+ * 331.3*sqrt(1+T/273.15) m/s as a third order polynomial, within 0.05% from -40 to 85 C.
+ */
+#define PING_SOUND_SPEED(celsius) \
+  ((uint32_t)((331300000LL + 606450LL*(celsius) - 555LL*(celsius)*(celsius) + \
+  1LL*(celsius)*(celsius)*(celsius) + 500LL) / 1000LL))
+#define PING_SOUND_SPEED_5(c) PING_SOUND_SPEED(c), PING_SOUND_SPEED(c+1), \
+  PING_SOUND_SPEED(c+2), PING_SOUND_SPEED(c+3), PING_SOUND_SPEED(c+4)
+#define PING_SOUND_SPEED_25(c) PING_SOUND_SPEED_5(c), PING_SOUND_SPEED_5(c+5), \
+  PING_SOUND_SPEED_5(c+10), PING_SOUND_SPEED_5(c+15), PING_SOUND_SPEED_5(c+20)
+
+// Speed of sound in mm/s, one entry per degree from PING_MIN_CELSIUS to PING_MAX_CELSIUS
+static const uint32_t ping_soundSpeedTable[PING_MAX_CELSIUS - PING_MIN_CELSIUS + 1] ICACHE_RODATA_ATTR = {
+  PING_SOUND_SPEED_25(-40), PING_SOUND_SPEED_25(-15), PING_SOUND_SPEED_25(10),
+  PING_SOUND_SPEED_25(35), PING_SOUND_SPEED_25(60), PING_SOUND_SPEED(85)
+};
+
+// The ambient conditions set by ping_setAmbient(NULL, ...)
+static int16_t ping_ambientCelsius = PING_AMBIENT_UNSET;
+static uint8_t ping_ambientHumidity = 0;
+static uint32_t ping_ambientGeneration = 0; // bumped by every change, wide enough to never wrap onto a stale value
+
+static void ping_setScale(Ping_Data *pingData, uint32_t soundSpeed);
+
+/**
+ * Returns the speed of sound (mm/s), humidity adds 12.4 mm/s per %RH
+ */
+static uint32_t ICACHE_FLASH_ATTR
+ping_soundSpeed(int16_t celsius, uint8_t humidity) {
+  if (celsius == PING_AMBIENT_UNSET) {
+    return PING_DEFAULT_SOUND_SPEED;
+  }
+  return ping_soundSpeedTable[celsius - PING_MIN_CELSIUS] + (humidity*124 + 5)/10;
+}
+
+/**
+ * Brings the conversion factors up to date with the global ambient setting.
+ * Only sensors without an ambient setting of their own follow the global one.
+ */
+static inline void
+ping_checkScale(Ping_Data *pingData) {
+  if (pingData->celsius == PING_AMBIENT_UNSET && pingData->ambientGeneration != ping_ambientGeneration) {
+    pingData->ambientGeneration = ping_ambientGeneration;
+    ping_setScale(pingData, ping_soundSpeed(ping_ambientCelsius, ping_ambientHumidity));
+  }
+}
+
+/**
+ * Sets the air temperature (celsius) and relative humidity (%) used to
+ * convert echo times to distances. Use pingData==NULL to set it for all
+ * sensors without a setting of their own, and celsius==PING_AMBIENT_UNSET
+ * to go back to the default (PING_US_TO_MM).
+ * The conversion factors are only recomputed when the values change.
+ */
+void ICACHE_FLASH_ATTR
+ping_setAmbient(Ping_Data *pingData, int16_t celsius, uint8_t humidity) {
+  if (celsius != PING_AMBIENT_UNSET) {
+    if (celsius < PING_MIN_CELSIUS) {
+      celsius = PING_MIN_CELSIUS;
+    } else if (celsius > PING_MAX_CELSIUS) {
+      celsius = PING_MAX_CELSIUS;
+    }
+    if (humidity > 100) {
+      humidity = 100;
+    }
+  } else {
+    humidity = 0;
+  }
+
+  if (pingData == NULL) {
+    if (celsius != ping_ambientCelsius || humidity != ping_ambientHumidity) {
+      ping_ambientCelsius = celsius;
+      ping_ambientHumidity = humidity;
+      ping_ambientGeneration++;
+    }
+    return;
+  }
+
+  if (celsius != pingData->celsius || humidity != pingData->humidity) {
+    pingData->celsius = celsius;
+    pingData->humidity = humidity;
+    if (celsius == PING_AMBIENT_UNSET) {
+      // follow the global setting again
+      pingData->ambientGeneration = ping_ambientGeneration - 1;
+      ping_checkScale(pingData);
+    } else {
+      ping_setScale(pingData, ping_soundSpeed(celsius, humidity));
+    }
+  }
+}
+
+/**
+ * Converts an echo time (in microseconds) into millimeters.
+ */
+uint32_t ICACHE_FLASH_ATTR
+ping_usToMm(Ping_Data *pingData, uint32_t echoTime) {
+  ping_checkScale(pingData);
+  return (echoTime * pingData->usToMm + (1 << (PING_US_TO_MM_SHIFT-1))) >> PING_US_TO_MM_SHIFT;
+}
+
+/**
+ * Converts an echo time (in microseconds) into 1/10 millimeters.
+ */
+uint32_t ICACHE_FLASH_ATTR
+ping_usToTenthMm(Ping_Data *pingData, uint32_t echoTime) {
+  ping_checkScale(pingData);
+  return (echoTime * pingData->usToTenthMm + (1 << (PING_US_TO_TENTH_MM_SHIFT-1))) >> PING_US_TO_TENTH_MM_SHIFT;
+}
+
+/**
+ * Converts a distance in 1/10 millimeters into an echo time (in microseconds).
+ * Distances above PING_MAX_TENTH_MM are clamped, the product would overflow.
+ */
+uint32_t ICACHE_FLASH_ATTR
+ping_tenthMmToUs(Ping_Data *pingData, uint32_t distance) {
+  ping_checkScale(pingData);
+  if (distance > PING_MAX_TENTH_MM) {
+    distance = PING_MAX_TENTH_MM;
+  }
+  return (distance * pingData->tenthMmToUs + (1 << (PING_TENTH_MM_TO_US_SHIFT-1))) >> PING_TENTH_MM_TO_US_SHIFT;
+}
+
+/**
+ * Sends a ping, and returns the response in millimeters.
+ * returns false if no result could be found.
+ */
+bool ICACHE_FLASH_ATTR
+ping_pingMm(Ping_Data *pingData, uint32_t maxDistance, uint32_t* returnDistance) {
+  uint32_t echoTime = 0;
+  if (maxDistance > PING_MAX_TENTH_MM/10) {
+    maxDistance = PING_MAX_TENTH_MM/10; // so that maxDistance*10 can't wrap
+  }
+  if (!ping_pingUs(pingData, ping_tenthMmToUs(pingData, maxDistance*10), &echoTime)) {
+    return false;
   }
+  *returnDistance = ping_usToMm(pingData, echoTime);
+  return true;
+}
 
-  *response = ping_timeStamp1 - ping_timeStamp0;
-  if (ping_timeStamp1 < ping_timeStamp0 || *response < 50) {
-    // probably a previous echo or clock overflow - false result
-    ping_disableInterrupt(ping_currentEchoPin);
-    ping_currentEchoPin = -1;
+/**
+ * Sends a ping, and returns the response in 1/10 millimeters.
+ * returns false if no result could be found.
+ */
+bool ICACHE_FLASH_ATTR
+ping_pingTenthMm(Ping_Data *pingData, uint32_t maxDistance, uint32_t* returnDistance) {
+  uint32_t echoTime = 0;
+  if (!ping_pingUs(pingData, ping_tenthMmToUs(pingData, maxDistance), &echoTime)) {
     return false;
   }
+  *returnDistance = ping_usToTenthMm(pingData, echoTime);
   return true;
 }
 
 bool ICACHE_FLASH_ATTR
 ping_ping(Ping_Data *pingData, float maxDistance, float* returnDistance) {
   uint32_t echoTime = 0;
-  uint32_t maxPeriod = 0;
+  ping_checkScale(pingData);
+  uint32_t maxPeriod = maxDistance * pingData->usPerUnit;
 
-  switch (pingData->unit) {
-    case PING_MM:
-      maxPeriod = maxDistance/PING_US_TO_MM;
-      break;
-    case PING_INCHES:
-      maxPeriod = maxDistance/PING_US_TO_INCH;
-      break;
-    default:
-      // Assume distance in micro-seconds
-      maxPeriod = (float) maxDistance;
-  }
   if (!ping_pingUs(pingData, maxPeriod, &echoTime)) {
-    //os_printf("ping_ping failed: maxPeriod=%d echoTime=%d\n",maxPeriod, (int)echoTime );
+    PING_LOG_DEBUG("ping_ping failed: maxPeriod=%d echoTime=%d\n", (int)maxPeriod, (int)echoTime);
     return false;
   }
+  *returnDistance = ((float) echoTime)*pingData->unitPerUs;
+  return true;
+}
+
+/**
+ * Sets the conversion factors between echo time and distance.
+ * 'soundSpeed' is the speed of sound in mm/s.
+ */
+static void ICACHE_FLASH_ATTR
+ping_setScale(Ping_Data *pingData, uint32_t soundSpeed) {
+  // the sound travels to the target and back, one us of echo is soundSpeed/2000000 mm.
+  // Rounded, a truncated factor is off by up to one unit in the last bit at every distance
+  pingData->usToMm = (((uint64_t) soundSpeed << PING_US_TO_MM_SHIFT) + 1000000) / 2000000;
+  pingData->usToTenthMm = (((uint64_t) soundSpeed << PING_US_TO_TENTH_MM_SHIFT) + 100000) / 200000;
+  pingData->tenthMmToUs = (((uint64_t) 200000 << PING_TENTH_MM_TO_US_SHIFT) + soundSpeed/2) / soundSpeed;
+
+  // the float factors used by ping_ping()
   switch (pingData->unit) {
     case PING_MM:
-      *returnDistance = ((float) echoTime)*PING_US_TO_MM;
+      pingData->unitPerUs = PING_US_TO_MM * soundSpeed / PING_DEFAULT_SOUND_SPEED;
       break;
     case PING_INCHES:
-      *returnDistance = ((float) echoTime)*PING_US_TO_INCH;
+      pingData->unitPerUs = PING_US_TO_INCH * soundSpeed / PING_DEFAULT_SOUND_SPEED;
       break;
     default:
       // Assume distance in micro-seconds
-      *returnDistance = (float) echoTime;
+      pingData->unitPerUs = 1.0;
   }
-  return true;
+  pingData->usPerUnit = 1.0/pingData->unitPerUs;
 }
 
 /**
@@ -215,28 +1463,58 @@ ping_init(Ping_Data *pingData, int8_t triggerPin, int8_t echoPin, Ping_Unit unit
   pingData->triggerPin = triggerPin;
   pingData->echoPin = echoPin;
   pingData->unit = unit;
+  pingData->state = PING_STATE_IDLE;
+  pingData->celsius = PING_AMBIENT_UNSET;
+  pingData->humidity = 0;
+  pingData->ambientGeneration = ping_ambientGeneration;
+  ping_setScale(pingData, ping_soundSpeed(ping_ambientCelsius, ping_ambientHumidity));
+  pingData->callback = NULL;
+  pingData->tracker = NULL;
+  pingData->status = PING_STATUS_OK;
+  ping_resetStats(pingData);
+  pingData->shortenedTimeouts = 0;
+  pingData->savedTime = 0;
+  ping_setAdaptiveTimeout(pingData, false);
   bool singlePinMode = false;
 
+  if (echoPin < 0 || echoPin >= PING_MAX_ECHO_PINS) {
+    PING_LOG_ERROR("ping_init: Error: GPIO%d can not be used as an echo pin\n", echoPin);
+    pingData->isInitiated = false;
+    return false;
+  }
+
+  if (!ping_taskIsInitiated) {
+    system_os_task(ping_task, PING_TASK_PRIO, ping_taskQueue, PING_TASK_QUEUE_LEN);
+
+    // FRC1 does all the timing, as a one shot timer
+    RTC_REG_WRITE(FRC1_CTRL_ADDRESS, PING_FRC1_DIVIDED_BY_16 | FRC1_ENABLE_TIMER);
+    ETS_FRC_TIMER1_INTR_ATTACH(ping_timer_intr_handler, NULL);
+    TM1_EDGE_INT_ENABLE();
+    ETS_FRC1_INTR_ENABLE();
+    ping_taskIsInitiated = true;
+  }
+
   if (triggerPin == echoPin) {
     singlePinMode = true;
   } else {
     if (!easygpio_pinMode(pingData->triggerPin, EASYGPIO_NOPULL, EASYGPIO_OUTPUT)){
-      os_printf("ping_init: Error: failed to set pinMode on trigger pin\n");
+      PING_LOG_ERROR("ping_init: Error: failed to set pinMode on trigger pin\n");
       return false;
     }
     GPIO_OUTPUT_SET(pingData->triggerPin, PING_TRIGGER_DEFAULT_STATE);
   }
 
-  if (easygpio_attachInterrupt(pingData->echoPin, EASYGPIO_NOPULL, ping_intr_handler, NULL)) {
+  if (easygpio_attachInterrupt(pingData->echoPin, EASYGPIO_NOPULL, ping_intr_handler, (void *)(size_t)pingData->echoPin)) {
+    ping_capture.pinConfig[pingData->echoPin] = GPIO_REG_READ(GPIO_PIN_ADDR(pingData->echoPin)) & ~GPIO_PIN_INT_TYPE_MASK;
     ping_allEchoPins |= BIT(pingData->echoPin);
     if (singlePinMode) {
       // easygpio_attachInterrupt() disables output, enable it again
       GPIO_OUTPUT_SET(pingData->triggerPin, PING_TRIGGER_DEFAULT_STATE);
     }
-    os_printf("\nInitiated ping module with trigger pin=%d echo pin=%d.\n\n",pingData->triggerPin, pingData->echoPin);
+    PING_LOG_INFO("\nInitiated ping module with trigger pin=%d echo pin=%d.\n\n",pingData->triggerPin, pingData->echoPin);
     pingData->isInitiated = true;
   } else {
-    os_printf("ping_init: Error: failed to set interrupt on echo pin %d\n", pingData->echoPin);
+    PING_LOG_ERROR("ping_init: Error: failed to set interrupt on echo pin %d\n", pingData->echoPin);
     pingData->isInitiated = false;
   }
   return pingData->isInitiated;
@@ -0,0 +1,172 @@
+/*
+* ping_filter.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ping/ping_filter.h"
+#include "osapi.h"
+#include "ping/ping_log.h"
+
+static inline uint32_t
+ping_filterMedian(Ping_Filter *filter) {
+  return filter->sorted[filter->count >> 1];
+}
+
+/**
+ * Removes 'value' from the sorted array and inserts 'newValue', shifting the
+ * elements in between. O(window).
+ */
+static void ICACHE_FLASH_ATTR
+ping_filterReplace(Ping_Filter *filter, uint32_t value, uint32_t newValue) {
+  uint8_t i = 0;
+  while (i < filter->count-1 && filter->sorted[i] != value) {
+    i++;
+  }
+  // i is now the hole left by 'value', move it towards the place of 'newValue'
+  while (i > 0 && filter->sorted[i-1] > newValue) {
+    filter->sorted[i] = filter->sorted[i-1];
+    i--;
+  }
+  while (i < filter->count-1 && filter->sorted[i+1] < newValue) {
+    filter->sorted[i] = filter->sorted[i+1];
+    i++;
+  }
+  filter->sorted[i] = newValue;
+}
+
+/**
+ * Inserts 'value' in a window that isn't full yet.
+ */
+static void ICACHE_FLASH_ATTR
+ping_filterInsert(Ping_Filter *filter, uint32_t value) {
+  uint8_t i = filter->count;
+  while (i > 0 && filter->sorted[i-1] > value) {
+    filter->sorted[i] = filter->sorted[i-1];
+    i--;
+  }
+  filter->sorted[i] = value;
+  filter->count++;
+}
+
+/**
+ * Returns the median absolute deviation of the samples in the window.
+ * The deviations below and above the median are two already sorted sequences,
+ * so this is a merge of the two, stopped half way. O(window).
+ */
+uint32_t ICACHE_FLASH_ATTR
+ping_filterMad(Ping_Filter *filter) {
+  uint8_t m = filter->count >> 1;
+  uint32_t median = 0;
+  int8_t lo = 0;
+  uint8_t hi = 0;
+  uint8_t n = 0;
+  uint32_t deviation = 0;
+
+  if (filter->count == 0) {
+    return 0;
+  }
+  median = filter->sorted[m];
+  lo = m;
+  hi = m + 1;
+  for (n = 0; n <= m; n++) {
+    if (lo >= 0 && (hi >= filter->count || median - filter->sorted[lo] <= filter->sorted[hi] - median)) {
+      deviation = median - filter->sorted[lo--];
+    } else {
+      deviation = filter->sorted[hi++] - median;
+    }
+  }
+  return deviation;
+}
+
+bool ICACHE_FLASH_ATTR
+ping_filterUpdate(Ping_Filter *filter, bool success, uint32_t value, uint32_t *filtered) {
+  uint32_t median = 0;
+  uint32_t mad = 0;
+  uint32_t deviation = 0;
+
+  if (!success) {
+    filter->dropouts++;
+  } else {
+    if (filter->madGate && filter->count > (filter->window >> 1)) {
+      median = ping_filterMedian(filter);
+      mad = ping_filterMad(filter);
+      if (mad < filter->minDeviation) {
+        mad = filter->minDeviation;
+      }
+      deviation = value > median ? value - median : median - value;
+      if (deviation <= filter->madGate * mad) {
+        filter->rejectedInARow = 0;
+      } else if (filter->rejectedInARow < (filter->window >> 1)) {
+        filter->rejectedInARow++;
+        filter->rejected++;
+        success = false;
+      }
+      // else: a target that really moved, let it through until the median has caught up
+    }
+    if (success) {
+      filter->accepted++;
+      if (filter->count < filter->window) {
+        filter->ring[(filter->head + filter->count) % filter->window] = value;
+        ping_filterInsert(filter, value);
+      } else {
+        ping_filterReplace(filter, filter->ring[filter->head], value);
+        filter->ring[filter->head] = value;
+        filter->head = filter->head + 1 == filter->window ? 0 : filter->head + 1;
+      }
+    }
+  }
+
+  if (filter->count == 0) {
+    return false;
+  }
+  *filtered = ping_filterMedian(filter);
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+ping_filterReset(Ping_Filter *filter) {
+  filter->count = 0;
+  filter->head = 0;
+  filter->rejectedInARow = 0;
+}
+
+bool ICACHE_FLASH_ATTR
+ping_filterInit(Ping_Filter *filter, uint8_t window, uint8_t madGate, uint32_t minDeviation) {
+  if (window < 1 || window > PING_FILTER_MAX_WINDOW) {
+    PING_LOG_ERROR("ping_filterInit: Error: the window must be 1 to %d samples.\n", PING_FILTER_MAX_WINDOW);
+    return false;
+  }
+  filter->window = window;
+  filter->madGate = madGate;
+  filter->minDeviation = minDeviation;
+  filter->accepted = 0;
+  filter->rejected = 0;
+  filter->dropouts = 0;
+  ping_filterReset(filter);
+  return true;
+}
@@ -0,0 +1,344 @@
+/*
+* ping_scheduler.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ping/ping_scheduler.h"
+#include "osapi.h"
+#include "ets_sys.h"
+#include "easygpio/easygpio.h"
+#include "os_type.h"
+#include "ping/ping_log.h"
+
+#define PING_SCHEDULER_LEARN_TOLERANCE 150 // 150 us (~25 mm), smallest echo time difference that counts as interference
+
+// forward declarations
+static void ping_schedulerNextRound(Ping_Scheduler *scheduler);
+static void ping_schedulerCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg);
+
+static int8_t ICACHE_FLASH_ATTR
+ping_schedulerIndexOf(Ping_Scheduler *scheduler, Ping_Data *pingData) {
+  int8_t i = 0;
+  for (i=0; i<scheduler->numberOfSensors; i++) {
+    if (scheduler->sensors[i] == pingData) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Packs the sensors into as few fire groups as possible, no group may contain two sensors
+ * that can hear each other. The most constrained sensors are placed first (Welsh-Powell).
+ */
+static void ICACHE_FLASH_ATTR
+ping_schedulerPackGroups(Ping_Scheduler *scheduler) {
+  uint8_t order[PING_SCHEDULER_MAX_SENSORS];
+  uint8_t degree[PING_SCHEDULER_MAX_SENSORS];
+  uint8_t i, j, g;
+
+  for (i=0; i<scheduler->numberOfSensors; i++) {
+    uint8_t d = easygpio_countBits(scheduler->interference[i]);
+    // insertion sort, highest degree first
+    for (j=i; j>0 && degree[j-1] < d; j--) {
+      degree[j] = degree[j-1];
+      order[j] = order[j-1];
+    }
+    degree[j] = d;
+    order[j] = i;
+  }
+
+  scheduler->numberOfGroups = 0;
+  for (i=0; i<scheduler->numberOfSensors; i++) {
+    uint8_t sensor = order[i];
+    for (g=0; g<scheduler->numberOfGroups; g++) {
+      if (!(scheduler->groups[g] & scheduler->interference[sensor])) {
+        break;
+      }
+    }
+    if (g == scheduler->numberOfGroups) {
+      scheduler->groups[g] = 0;
+      scheduler->numberOfGroups++;
+    }
+    scheduler->groups[g] |= BIT(sensor);
+  }
+  scheduler->currentGroup = 0;
+}
+
+/**
+ * Returns true if the learning result of sensor 'i' differs from its baseline.
+ */
+static bool ICACHE_FLASH_ATTR
+ping_schedulerDiffers(Ping_Scheduler *scheduler, uint8_t i) {
+  bool ok = (scheduler->resultOk & BIT(i)) != 0;
+  uint32_t tolerance = scheduler->baseline[i]/16;
+  uint32_t diff = 0;
+
+  if (ok != ((scheduler->baselineOk & BIT(i)) != 0)) {
+    return true;
+  }
+  if (!ok) {
+    return false;
+  }
+  if (tolerance < PING_SCHEDULER_LEARN_TOLERANCE) {
+    tolerance = PING_SCHEDULER_LEARN_TOLERANCE;
+  }
+  diff = scheduler->result[i] > scheduler->baseline[i] ?
+      scheduler->result[i] - scheduler->baseline[i] : scheduler->baseline[i] - scheduler->result[i];
+  return diff > tolerance;
+}
+
+/**
+ * Returns the sensors to fire in the next round, and updates the learning state.
+ */
+static uint16_t ICACHE_FLASH_ATTR
+ping_schedulerNextMask(Ping_Scheduler *scheduler) {
+  switch (scheduler->state) {
+    case PING_SCHEDULER_RUNNING:
+      return scheduler->groups[scheduler->currentGroup];
+    case PING_SCHEDULER_LEARN_BASELINE:
+      return BIT(scheduler->learnA);
+    case PING_SCHEDULER_LEARN_PAIRS:
+      return BIT(scheduler->learnA) | BIT(scheduler->learnB);
+    default:
+      return 0;
+  }
+}
+
+/**
+ * Called when every sensor of a round has reported back.
+ */
+static void ICACHE_FLASH_ATTR
+ping_schedulerRoundDone(Ping_Scheduler *scheduler) {
+  uint8_t i = 0;
+
+  switch (scheduler->state) {
+    case PING_SCHEDULER_RUNNING:
+      scheduler->rounds++;
+      scheduler->currentGroup = (scheduler->currentGroup + 1) % scheduler->numberOfGroups;
+      break;
+    case PING_SCHEDULER_LEARN_BASELINE:
+      i = scheduler->learnA;
+      scheduler->baseline[i] = scheduler->result[i];
+      scheduler->baselineOk = (scheduler->baselineOk & ~BIT(i)) | (scheduler->resultOk & BIT(i));
+      if (++scheduler->learnA >= scheduler->numberOfSensors) {
+        scheduler->state = PING_SCHEDULER_LEARN_PAIRS;
+        scheduler->learnA = 0;
+        scheduler->learnB = 1;
+        if (scheduler->learnB >= scheduler->numberOfSensors) {
+          // a single sensor, nothing to pair
+          ping_schedulerPackGroups(scheduler);
+          scheduler->state = PING_SCHEDULER_RUNNING;
+        }
+      }
+      break;
+    case PING_SCHEDULER_LEARN_PAIRS:
+      if (ping_schedulerDiffers(scheduler, scheduler->learnA) || ping_schedulerDiffers(scheduler, scheduler->learnB)) {
+        ping_schedulerSetInterference(scheduler, scheduler->learnA, scheduler->learnB, true);
+      }
+      if (++scheduler->learnB >= scheduler->numberOfSensors) {
+        scheduler->learnA++;
+        scheduler->learnB = scheduler->learnA + 1;
+      }
+      if (scheduler->learnB >= scheduler->numberOfSensors) {
+        // all pairs are tested
+        ping_schedulerPackGroups(scheduler);
+        scheduler->state = PING_SCHEDULER_RUNNING;
+      }
+      break;
+    default:
+      // stopped
+      return;
+  }
+
+  if (scheduler->groupDelay) {
+    os_timer_disarm(&scheduler->timer);
+    os_timer_arm(&scheduler->timer, scheduler->groupDelay, false);
+  } else {
+    ping_schedulerNextRound(scheduler);
+  }
+}
+
+/**
+ * Fires every sensor of the next round at once.
+ */
+static void ICACHE_FLASH_ATTR
+ping_schedulerNextRound(Ping_Scheduler *scheduler) {
+  uint16_t mask = ping_schedulerNextMask(scheduler);
+  Ping_Data *group[PING_SCHEDULER_MAX_SENSORS];
+  uint8_t indexes[PING_SCHEDULER_MAX_SENSORS];
+  uint8_t count = 0;
+  uint16_t started = 0;
+  uint8_t i = 0;
+
+  for (i=0; mask; i++, mask>>=1) {
+    if (mask & 1) {
+      group[count] = scheduler->sensors[i];
+      indexes[count++] = i;
+    }
+  }
+  scheduler->pending = 0;
+  scheduler->resultOk = 0;
+  // the whole group is triggered on the same cycle
+  started = ping_startAsyncGroup(group, count, scheduler->maxPeriod, ping_schedulerCallback, scheduler);
+  for (i=0; i<count; i++) {
+    if (started & BIT(i)) {
+      scheduler->pending |= BIT(indexes[i]);
+    }
+  }
+  if (!scheduler->pending && PING_SCHEDULER_IDLE != scheduler->state) {
+    // nothing could be started, try again later
+    os_timer_disarm(&scheduler->timer);
+    os_timer_arm(&scheduler->timer, scheduler->groupDelay ? scheduler->groupDelay : 1, false);
+  }
+}
+
+static void ICACHE_FLASH_ATTR
+ping_schedulerTimerCallback(void *arg) {
+  Ping_Scheduler *scheduler = (Ping_Scheduler *) arg;
+  if (!scheduler->pending) {
+    ping_schedulerNextRound(scheduler);
+  }
+}
+
+static void ICACHE_FLASH_ATTR
+ping_schedulerCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  Ping_Scheduler *scheduler = (Ping_Scheduler *) arg;
+  int8_t i = ping_schedulerIndexOf(scheduler, pingData);
+
+  if (i < 0) {
+    return;
+  }
+  scheduler->pending &= ~BIT(i);
+  if (PING_SCHEDULER_LEARN_BASELINE == scheduler->state || PING_SCHEDULER_LEARN_PAIRS == scheduler->state) {
+    scheduler->result[i] = echoTime;
+    if (success) {
+      scheduler->resultOk |= BIT(i);
+    }
+  } else if (scheduler->callback) {
+    scheduler->samples++;
+    scheduler->callback(pingData, success, echoTime, scheduler->callbackArg);
+  }
+  if (!scheduler->pending) {
+    ping_schedulerRoundDone(scheduler);
+  }
+}
+
+/**
+ * Initiates the scheduler. Every result will be delivered to 'callback', just like ping_startAsync() does.
+ * maxPeriod is the time out in microseconds of each ping.
+ */
+void ICACHE_FLASH_ATTR
+ping_schedulerInit(Ping_Scheduler *scheduler, uint32_t maxPeriod, Ping_Callback callback, void *arg) {
+  os_memset(scheduler, 0, sizeof(Ping_Scheduler));
+  scheduler->maxPeriod = maxPeriod;
+  scheduler->callback = callback;
+  scheduler->callbackArg = arg;
+  scheduler->state = PING_SCHEDULER_IDLE;
+  os_timer_disarm(&scheduler->timer);
+  os_timer_setfn(&scheduler->timer, (os_timer_func_t *) ping_schedulerTimerCallback, scheduler);
+}
+
+/**
+ * Adds an initiated sensor to the scheduler. Returns the index of the sensor or -1 if the scheduler is full.
+ * Sensors are assumed to not interfere with each other until told otherwise.
+ */
+int8_t ICACHE_FLASH_ATTR
+ping_schedulerAdd(Ping_Scheduler *scheduler, Ping_Data *pingData) {
+  if (scheduler->numberOfSensors >= PING_SCHEDULER_MAX_SENSORS) {
+    PING_LOG_ERROR("ping_schedulerAdd: Error: too many sensors.\n");
+    return -1;
+  }
+  scheduler->sensors[scheduler->numberOfSensors] = pingData;
+  scheduler->interference[scheduler->numberOfSensors] = 0;
+  return scheduler->numberOfSensors++;
+}
+
+/**
+ * Declares that sensor 'a' and sensor 'b' (as indexes returned by ping_schedulerAdd()) can hear each other.
+ */
+void ICACHE_FLASH_ATTR
+ping_schedulerSetInterference(Ping_Scheduler *scheduler, uint8_t a, uint8_t b, bool interferes) {
+  if (a == b || a >= scheduler->numberOfSensors || b >= scheduler->numberOfSensors) {
+    return;
+  }
+  if (interferes) {
+    scheduler->interference[a] |= BIT(b);
+    scheduler->interference[b] |= BIT(a);
+  } else {
+    scheduler->interference[a] &= ~BIT(b);
+    scheduler->interference[b] &= ~BIT(a);
+  }
+}
+
+/**
+ * Sets the time (in ms) to wait between two fire groups, to let the echoes of the previous group die out.
+ */
+void ICACHE_FLASH_ATTR
+ping_schedulerSetGroupDelay(Ping_Scheduler *scheduler, uint32_t ms) {
+  scheduler->groupDelay = ms;
+}
+
+/**
+ * Measures which sensors that can hear each other, and then starts the scheduler.
+ */
+bool ICACHE_FLASH_ATTR
+ping_schedulerLearn(Ping_Scheduler *scheduler) {
+  if (scheduler->pending || PING_SCHEDULER_IDLE != scheduler->state || !scheduler->numberOfSensors) {
+    return false;
+  }
+  scheduler->baselineOk = 0;
+  scheduler->learnA = 0;
+  scheduler->learnB = 1;
+  scheduler->state = PING_SCHEDULER_LEARN_BASELINE;
+  ping_schedulerNextRound(scheduler);
+  return true;
+}
+
+/**
+ * Packs the sensors into fire groups and starts cycling through them.
+ */
+bool ICACHE_FLASH_ATTR
+ping_schedulerStart(Ping_Scheduler *scheduler) {
+  if (scheduler->pending || PING_SCHEDULER_IDLE != scheduler->state || !scheduler->numberOfSensors) {
+    return false;
+  }
+  ping_schedulerPackGroups(scheduler);
+  scheduler->state = PING_SCHEDULER_RUNNING;
+  ping_schedulerNextRound(scheduler);
+  return true;
+}
+
+/**
+ * Stops the scheduler after the current fire group has completed.
+ */
+void ICACHE_FLASH_ATTR
+ping_schedulerStop(Ping_Scheduler *scheduler) {
+  scheduler->state = PING_SCHEDULER_IDLE;
+  os_timer_disarm(&scheduler->timer);
+}
@@ -0,0 +1,140 @@
+/*
+* ping_tracker.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ping/ping_tracker.h"
+#include "osapi.h"
+
+/**
+ * Returns the distance (PING_TRACKER_SHIFT fixed point) predicted 'dt' us after the last measurement.
+ */
+static int32_t ICACHE_FLASH_ATTR
+ping_trackerExtrapolate(Ping_Tracker *tracker, uint32_t dt) {
+  return tracker->distance + (int32_t)(((int64_t)tracker->velocity * dt) / 1000000);
+}
+
+void ICACHE_FLASH_ATTR
+ping_trackerUpdate(Ping_Tracker *tracker, Ping_Data *pingData, bool success, uint32_t echoTime, uint32_t timeStamp) {
+  int32_t measured = 0;
+  int32_t predicted = 0;
+  int32_t residual = 0;
+  uint32_t dt = timeStamp - tracker->lastTime;
+
+  if (!success) {
+    // coast, the next measurement will be compared to a prediction further ahead
+    if (tracker->samples && ++tracker->misses > tracker->maxMisses) {
+      tracker->samples = 0;
+      tracker->lost++;
+    }
+    return;
+  }
+
+  measured = ping_usToTenthMm(pingData, echoTime) << PING_TRACKER_SHIFT;
+  tracker->misses = 0;
+  if (tracker->samples == 0 || dt == 0) {
+    tracker->distance = measured;
+    tracker->velocity = 0;
+    tracker->lastTime = timeStamp;
+    tracker->samples = 1;
+    return;
+  }
+  if (tracker->samples == 1) {
+    // two points, the velocity is just the difference
+    tracker->velocity = (int32_t)(((int64_t)(measured - tracker->distance) * 1000000) / dt);
+    tracker->distance = measured;
+    tracker->lastTime = timeStamp;
+    tracker->samples = 2;
+    return;
+  }
+
+  predicted = ping_trackerExtrapolate(tracker, dt);
+  residual = measured - predicted;
+  tracker->distance = predicted + (int32_t)(((int64_t)residual * tracker->alpha) >> PING_TRACKER_SHIFT);
+  tracker->velocity += (int32_t)((((int64_t)residual * tracker->beta) >> PING_TRACKER_SHIFT) * 1000000 / dt);
+  tracker->lastTime = timeStamp;
+}
+
+bool ICACHE_FLASH_ATTR
+ping_trackerGet(Ping_Tracker *tracker, int32_t *distance, int32_t *velocity) {
+  if (tracker->samples == 0) {
+    return false;
+  }
+  *distance = tracker->distance >> PING_TRACKER_SHIFT;
+  *velocity = tracker->velocity >> PING_TRACKER_SHIFT;
+  return true;
+}
+
+bool ICACHE_FLASH_ATTR
+ping_trackerPredict(Ping_Tracker *tracker, uint32_t timeStamp, int32_t *distance) {
+  if (tracker->samples == 0) {
+    return false;
+  }
+  *distance = ping_trackerExtrapolate(tracker, timeStamp - tracker->lastTime) >> PING_TRACKER_SHIFT;
+  return true;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+ping_trackerTimeout(Ping_Tracker *tracker, Ping_Data *pingData, uint32_t timeStamp, uint32_t maxPeriod) {
+  int32_t distance = 0;
+  uint32_t timeout = 0;
+
+  if (tracker->window == 0 || tracker->samples < 2 || !ping_trackerPredict(tracker, timeStamp, &distance)) {
+    return maxPeriod;
+  }
+  // every missed sample widens the window
+  distance += tracker->window * (1 + tracker->misses);
+  if (distance <= 0) {
+    distance = tracker->window;
+  } else if (distance > PING_MAX_TENTH_MM) {
+    // beyond what ping_tenthMmToUs() converts, don't narrow anything
+    return maxPeriod;
+  }
+  timeout = ping_tenthMmToUs(pingData, distance) + PING_TRACKER_OVERHEAD;
+  return timeout < maxPeriod ? timeout : maxPeriod;
+}
+
+void ICACHE_FLASH_ATTR
+ping_trackerDetach(Ping_Data *pingData) {
+  pingData->tracker = NULL;
+}
+
+void ICACHE_FLASH_ATTR
+ping_trackerInit(Ping_Tracker *tracker, Ping_Data *pingData, uint16_t alpha, uint16_t beta,
+    uint32_t window, uint8_t maxMisses) {
+  tracker->alpha = alpha;
+  tracker->beta = beta;
+  tracker->window = window;
+  tracker->maxMisses = maxMisses;
+  tracker->misses = 0;
+  tracker->samples = 0;
+  tracker->lost = 0;
+  if (pingData) {
+    pingData->tracker = tracker;
+  }
+}
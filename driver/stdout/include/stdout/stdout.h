@@ -9,4 +9,13 @@
  * ----------------------------------------------------------------------------
  */
 
+#include "c_types.h"
+
 void stdout_init(void);
+
+//Writes raw bytes (no \n -> \r\n conversion) through the same buffer as os_printf.
+//Returns the number of bytes that were not dropped.
+uint16 stdout_write(const uint8 *data, uint16 length);
+
+//Returns the number of bytes dropped because the output buffer was full.
+uint32 stdout_getDropped(void);
@@ -13,11 +13,72 @@
 #include "osapi.h"
 #include "stdout/uart_hw.h"
 
+//Size of the TX ring buffer, must be a power of 2. Define STDOUT_BUFFER_SIZE in user_config.h to change it.
+#ifndef STDOUT_BUFFER_SIZE
+#define STDOUT_BUFFER_SIZE 512
+#endif
+//The UART raises the TX FIFO empty interrupt when there are fewer than this many bytes left in the FIFO
+#define STDOUT_FIFO_EMPTY_THRESHOLD 16
+#define STDOUT_FIFO_SIZE 126
+
+//The ring buffer is filled by stdoutUartTxd() and drained by the UART interrupt handler.
+//When it is full new bytes are dropped (and counted), unless STDOUT_BLOCK_WHEN_FULL is defined
+//in user_config.h. Then the caller waits for the UART, like it always did.
+static char stdoutBuffer[STDOUT_BUFFER_SIZE];
+static volatile uint16 stdoutHead = 0; //written by stdoutUartTxd() only
+static volatile uint16 stdoutTail = 0; //written by the interrupt handler (or with it disabled)
+static volatile uint32 stdoutDropped = 0;
+
+static inline uint32 stdoutFifoCount(void) {
+	return (READ_PERI_REG(UART_STATUS(0))>>UART_TXFIFO_CNT_S)&UART_TXFIFO_CNT;
+}
+
+//Moves as much as fits from the ring buffer to the FIFO.
+//Must be called from the interrupt handler, or with the UART interrupt disabled.
+static void stdoutFillFifo(void) {
+	uint16 tail=stdoutTail;
+	uint32 room=STDOUT_FIFO_SIZE-stdoutFifoCount();
+	while (room-- > 0 && tail!=stdoutHead) {
+		WRITE_PERI_REG(UART_FIFO(0), stdoutBuffer[tail]);
+		tail=(tail+1)&(STDOUT_BUFFER_SIZE-1);
+	}
+	stdoutTail=tail;
+	if (tail==stdoutHead) {
+		//Nothing left, no need to hear about an empty FIFO
+		CLEAR_PERI_REG_MASK(UART_INT_ENA(0), UART_TXFIFO_EMPTY_INT_ENA);
+	}
+}
+
+static void stdoutUartIntrHandler(void *arg) {
+	uint32 status=READ_PERI_REG(UART_INT_ST(0));
+	if (status&UART_TXFIFO_EMPTY_INT_ST) {
+		stdoutFillFifo();
+	}
+	WRITE_PERI_REG(UART_INT_CLR(0), status);
+}
+
 static void ICACHE_FLASH_ATTR stdoutUartTxd(char c) {
-	//Wait until there is room in the FIFO
-	while (((READ_PERI_REG(UART_STATUS(0))>>UART_TXFIFO_CNT_S)&UART_TXFIFO_CNT)>=126) ;
-	//Send the character
-	WRITE_PERI_REG(UART_FIFO(0), c);
+	uint16 head=stdoutHead;
+	uint16 next=(head+1)&(STDOUT_BUFFER_SIZE-1);
+	if (head==stdoutTail && stdoutFifoCount()<STDOUT_FIFO_SIZE) {
+		//Nothing queued and room in the FIFO, send the character right away
+		WRITE_PERI_REG(UART_FIFO(0), c);
+		return;
+	}
+	if (next==stdoutTail) {
+#ifdef STDOUT_BLOCK_WHEN_FULL
+		//Wait until there is room in the buffer
+		ETS_UART_INTR_DISABLE();
+		while (next==stdoutTail) stdoutFillFifo();
+		ETS_UART_INTR_ENABLE();
+#else
+		stdoutDropped++;
+		return;
+#endif
+	}
+	stdoutBuffer[head]=c;
+	stdoutHead=next;
+	SET_PERI_REG_MASK(UART_INT_ENA(0), UART_TXFIFO_EMPTY_INT_ENA);
 }
 
 static void ICACHE_FLASH_ATTR stdoutPutchar(char c) {
@@ -44,6 +105,29 @@ stdout_init() {
 	//Clear pending interrupts
 	WRITE_PERI_REG(UART_INT_CLR(0), 0xffff);
 
+	//Let the TX FIFO empty interrupt drain the buffer
+	CLEAR_PERI_REG_MASK(UART_CONF1(0), UART_TXFIFO_EMPTY_THRHD<<UART_TXFIFO_EMPTY_THRHD_S);
+	SET_PERI_REG_MASK(UART_CONF1(0), (STDOUT_FIFO_EMPTY_THRESHOLD&UART_TXFIFO_EMPTY_THRHD)<<UART_TXFIFO_EMPTY_THRHD_S);
+	WRITE_PERI_REG(UART_INT_ENA(0), 0);
+	ETS_UART_INTR_ATTACH(stdoutUartIntrHandler, NULL);
+	ETS_UART_INTR_ENABLE();
+
 	//Install our own putchar handler
 	os_install_putc1((void *)stdoutPutchar);
 }
+
+//Writes raw bytes (no \n -> \r\n conversion) through the same buffer as os_printf.
+//Returns the number of bytes that were not dropped.
+uint16 ICACHE_FLASH_ATTR
+stdout_write(const uint8 *data, uint16 length) {
+	uint32 dropped=stdoutDropped;
+	uint16 i;
+	for (i=0; i<length; i++) stdoutUartTxd(data[i]);
+	return length-(uint16)(stdoutDropped-dropped);
+}
+
+//Returns the number of bytes dropped because the buffer was full.
+uint32 ICACHE_FLASH_ATTR
+stdout_getDropped(void) {
+	return stdoutDropped;
+}
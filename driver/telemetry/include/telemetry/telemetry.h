@@ -0,0 +1,92 @@
+/*
+* telemetry.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TELEMETRY_INCLUDE_TELEMETRY_TELEMETRY_H_
+#define TELEMETRY_INCLUDE_TELEMETRY_TELEMETRY_H_
+
+#include "c_types.h"
+
+/**
+ * A compact binary stream of samples.
+ *
+ * Every frame is COBS encoded, with a 0x00 byte on each side. A decoded frame is a number of records
+ * followed by a CRC-16/CCITT-FALSE (big endian) of the records. Each record is:
+ *   header:   one byte, sensor id << 3 | status (0 is success)
+ *   time:     varint, ms since the previous record of the frame (the first record: ms since boot)
+ *   distance: zigzag varint, change since the previous record of the same sensor in the frame
+ *             (or since 0). Only present when status is 0.
+ * Frames don't depend on each other, so a lost frame only loses its own records.
+ * tools/telemetry_decode.c turns a captured stream into CSV.
+ */
+
+#define TELEMETRY_MAX_SENSORS 32
+#define TELEMETRY_MAX_STATUS 7
+#define TELEMETRY_FRAME_SIZE 64 // records + CRC, before COBS encoding
+
+/**
+ * Where the encoded frames go, stdout_write() fits.
+ */
+typedef uint16 (*Telemetry_Write)(const uint8 *data, uint16 length);
+
+typedef struct {
+  // 'private' data, don't change anything in here
+  uint8 frame[TELEMETRY_FRAME_SIZE];
+  uint8 length;
+  uint32 lastTime;
+  uint32 lastDistance[TELEMETRY_MAX_SENSORS];
+  uint32 hasDistance; // bit i is set if sensor i has a record with a distance in the frame
+  Telemetry_Write write;
+  uint32 frames;
+  uint32 records;
+} Telemetry;
+
+/**
+ * Initiates the stream, the frames are handed to 'write'.
+ */
+void telemetry_init(Telemetry *telemetry, Telemetry_Write write);
+
+/**
+ * Adds a sample to the current frame, the frame is sent when full.
+ * 'time' is in ms, 'distance' in any unit. Returns false if sensorId or status is out of range.
+ */
+bool telemetry_add(Telemetry *telemetry, uint8 sensorId, uint32 time, uint32 distance, uint8 status);
+
+/**
+ * Sends the current frame, if it has any records.
+ */
+void telemetry_flush(Telemetry *telemetry);
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff) of 'length' bytes.
+ */
+uint16 telemetry_crc16(const uint8 *data, uint16 length);
+
+#endif /* TELEMETRY_INCLUDE_TELEMETRY_TELEMETRY_H_ */
@@ -0,0 +1,137 @@
+/*
+* telemetry.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "telemetry/telemetry.h"
+#include "osapi.h"
+
+#define TELEMETRY_MAX_RECORD 11 // header + 5 byte varint + 5 byte varint
+#define TELEMETRY_CRC_SIZE 2
+
+uint16 ICACHE_FLASH_ATTR
+telemetry_crc16(const uint8 *data, uint16 length) {
+  uint16 crc = 0xffff;
+  uint8 i = 0;
+  while (length--) {
+    crc ^= (uint16)(*data++) << 8;
+    for (i=0; i<8; i++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static uint8 ICACHE_FLASH_ATTR
+telemetry_putVarint(uint8 *buffer, uint32 value) {
+  uint8 length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = (uint8)value | 0x80;
+    value >>= 7;
+  }
+  buffer[length++] = (uint8)value;
+  return length;
+}
+
+/**
+ * COBS encodes 'length' bytes of 'data' into 'out' (which must hold length + length/254 + 3 bytes),
+ * between two 0x00 delimiters. Returns the encoded length.
+ * The leading delimiter ends whatever console text came before the frame.
+ */
+static uint16 ICACHE_FLASH_ATTR
+telemetry_cobsEncode(const uint8 *data, uint16 length, uint8 *out) {
+  uint16 code = 1; // index of the current code byte
+  uint16 o = 2;
+  uint16 i = 0;
+  out[0] = 0;
+  for (i=0; i<length; i++) {
+    if (data[i]) {
+      out[o++] = data[i];
+    }
+    if (!data[i] || o - code == 0xff) {
+      out[code] = o - code;
+      code = o++;
+    }
+  }
+  out[code] = o - code;
+  out[o++] = 0;
+  return o;
+}
+
+void ICACHE_FLASH_ATTR
+telemetry_flush(Telemetry *telemetry) {
+  uint8 encoded[TELEMETRY_FRAME_SIZE + TELEMETRY_FRAME_SIZE/254 + 3];
+  uint16 crc = 0;
+
+  if (!telemetry->length) {
+    return;
+  }
+  crc = telemetry_crc16(telemetry->frame, telemetry->length);
+  telemetry->frame[telemetry->length++] = crc >> 8;
+  telemetry->frame[telemetry->length++] = crc & 0xff;
+  telemetry->write(encoded, telemetry_cobsEncode(telemetry->frame, telemetry->length, encoded));
+  telemetry->frames++;
+  telemetry->length = 0;
+  telemetry->hasDistance = 0;
+}
+
+bool ICACHE_FLASH_ATTR
+telemetry_add(Telemetry *telemetry, uint8 sensorId, uint32 time, uint32 distance, uint8 status) {
+  uint8 *record = NULL;
+  int32 change = 0;
+
+  if (sensorId >= TELEMETRY_MAX_SENSORS || status > TELEMETRY_MAX_STATUS) {
+    return false;
+  }
+  if (telemetry->length + TELEMETRY_MAX_RECORD > TELEMETRY_FRAME_SIZE - TELEMETRY_CRC_SIZE) {
+    telemetry_flush(telemetry);
+  }
+  record = telemetry->frame + telemetry->length;
+  *record++ = sensorId << 3 | status;
+  record += telemetry_putVarint(record, telemetry->length ? time - telemetry->lastTime : time);
+  telemetry->lastTime = time;
+  if (!status) {
+    change = (int32)(distance - (telemetry->hasDistance & BIT(sensorId) ? telemetry->lastDistance[sensorId] : 0));
+    record += telemetry_putVarint(record, ((uint32)change << 1) ^ (uint32)(change >> 31)); // zigzag
+    telemetry->lastDistance[sensorId] = distance;
+    telemetry->hasDistance |= BIT(sensorId);
+  }
+  telemetry->length = record - telemetry->frame;
+  telemetry->records++;
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+telemetry_init(Telemetry *telemetry, Telemetry_Write write) {
+  telemetry->length = 0;
+  telemetry->hasDistance = 0;
+  telemetry->lastTime = 0;
+  telemetry->write = write;
+  telemetry->frames = 0;
+  telemetry->records = 0;
+}
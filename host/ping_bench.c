@@ -0,0 +1,461 @@
+/*
+* ping_bench.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "ping/ping.h"
+#include "ping/ping_filter.h"
+#include "ping/ping_scheduler.h"
+#include "easygpio/easygpio.h"
+#include "gpio.h"
+
+/**
+ * Throughput and CPU cost of the ping driver, against simulated sensors. Prints one JSON object
+ * per line, so that the output of two driver versions can be diffed:
+ *
+ *   make -C host bench > before.jsonl
+ *   ...
+ *   make -C host bench > after.jsonl
+ *   diff before.jsonl after.jsonl
+ *
+ * Everything runs on the virtual clock of the simulator, so the results are the same on every run.
+ * With -t the cost of the median filter is also measured, on the host CPU and with the wall clock,
+ * those numbers only compare with each other.
+ */
+
+#define BENCH_PINGS 200         // pings per sensor and configuration
+#define BENCH_ISR_COST 3        // us charged per interrupt handler call, a guess at the real thing
+#define BENCH_BURST 200         // pings per ping_burst(), at most 255
+#define BENCH_VALID_SLACK (BENCH_ISR_COST + 2) // us, a sample further than this from the target is wrong
+#define BENCH_SCHEDULER_TIME 2000000 // us of virtual time per scheduler configuration
+#define BENCH_MAX_SENSORS 12
+#define BENCH_HOST_LOOPS 10000000
+#define BENCH_TOGGLES 1000
+#define BENCH_SPREAD 50 // mm between the targets of two sensors, so that their echoes don't end together
+
+// The pins with interrupts that aren't used by the flash
+static const uint8_t singlePins[BENCH_MAX_SENSORS] = {4, 5, 12, 13, 14, 15, 0, 2, 9, 10, 1, 3};
+static const uint8_t triggerPins[BENCH_MAX_SENSORS/2] = {4, 12, 14, 0, 9, 1};
+static const uint8_t echoPins[BENCH_MAX_SENSORS/2] = {5, 13, 15, 2, 10, 3};
+
+static const uint8_t sensorCounts[] = {1, 2, 4};
+static const uint32_t distances[] = {200, 1000, 3000};  // mm
+static const uint32_t maxRanges[] = {2000, 4000};       // mm
+static const uint8_t schedulerCounts[] = {2, 4, 8, 12};
+static const uint8_t togglePins[] = {4, 5, 12, 13};
+
+#define COUNT(array) (sizeof(array)/sizeof(array[0]))
+#define MM_PER_INCH 25.4f
+
+static Ping_Data sensors[BENCH_MAX_SENSORS];
+static Sim_Response responses[BENCH_MAX_SENSORS];
+static uint32_t times[BENCH_PINGS * BENCH_MAX_SENSORS];
+
+static int
+compareTimes(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Sorts 'times' and returns the 'percent' percentile.
+ */
+static uint32_t
+percentile(uint32_t *times, uint32_t count, uint8_t percent) {
+  if (!count) {
+    return 0;
+  }
+  qsort(times, count, sizeof(uint32_t), compareTimes);
+  return times[(count - 1) * percent / 100];
+}
+
+static uint32_t
+echoTimeOf(uint32_t distance) {
+  // mm to us, at the default speed of sound
+  return distance * 58 / 10;
+}
+
+/**
+ * Resets the simulator and sets up 'count' sensors, looking at targets 'distance' mm away and further.
+ */
+static void
+setupSensors(uint8_t count, bool isSinglePin, uint32_t distance, Ping_Unit unit) {
+  uint8_t i = 0;
+  sim_init(0, 0);
+  sim_setIsrCost(BENCH_ISR_COST);
+  for (i=0; i<count; i++) {
+    responses[i].type = SIM_ECHO;
+    responses[i].echoTime = echoTimeOf(distance + i*BENCH_SPREAD);
+    responses[i].ghostTime = 0;
+    if (isSinglePin) {
+      sim_addSensor(singlePins[i], singlePins[i], &responses[i], 1, true);
+      ping_initOnePinMode(&sensors[i], singlePins[i], unit);
+    } else {
+      sim_addSensor(triggerPins[i], echoPins[i], &responses[i], 1, true);
+      ping_init(&sensors[i], triggerPins[i], echoPins[i], unit);
+    }
+  }
+}
+
+/**
+ * Busy time as a fraction of the elapsed time: os_delay_us() and the interrupt handlers.
+ */
+static double
+busyFraction(uint64_t elapsed) {
+  Sim_Stats stats;
+  sim_getStats(&stats, false);
+  return elapsed ? (double)stats.busyTime / elapsed : 0;
+}
+
+/**
+ * ping_ping() back to back, round robin over the sensors.
+ */
+static void
+benchPing(uint8_t count, bool isSinglePin, uint32_t distance, uint32_t maxRange, Ping_Unit unit) {
+  float maxDistance = PING_MM == unit ? maxRange : maxRange / MM_PER_INCH;
+  uint32_t failures = 0;
+  uint32_t samples = 0;
+  uint64_t start = 0;
+  uint64_t elapsed = 0;
+  uint32_t p50 = 0;
+  uint32_t p99 = 0;
+  uint32_t i = 0;
+
+  setupSensors(count, isSinglePin, distance, unit);
+  start = sim_now();
+  for (i=0; i<BENCH_PINGS*count; i++) {
+    uint64_t pingStart = sim_now();
+    float result = 0;
+    if (!ping_ping(&sensors[i % count], maxDistance, &result)) {
+      failures++;
+    }
+    times[samples++] = (uint32_t)(sim_now() - pingStart);
+  }
+  elapsed = sim_now() - start;
+  p50 = percentile(times, samples, 50);
+  p99 = percentile(times, samples, 99);
+  printf("{\"bench\":\"ping\",\"mode\":\"%s\",\"sensors\":%u,\"distance_mm\":%u,\"max_range_mm\":%u,"
+         "\"unit\":\"%s\",\"samples\":%u,\"samples_per_sec\":%.1f,\"cpu_busy\":%.4f,"
+         "\"p50_us\":%u,\"p99_us\":%u,\"failure_rate\":%.4f}\n",
+         isSinglePin ? "single_pin" : "two_pin", count, distance, maxRange,
+         PING_MM == unit ? "mm" : "inch", samples, samples * 1000000.0 / elapsed, busyFraction(elapsed),
+         p50, p99, (double)failures / samples);
+}
+
+typedef struct {
+  bool done;
+  uint8_t successes;
+} BurstResult;
+
+static void
+burstCallback(Ping_Data *pingData, uint8_t successes, uint32_t results[], void *arg) {
+  BurstResult *result = (BurstResult *)arg;
+  result->done = true;
+  result->successes = successes;
+}
+
+static bool
+isBurstDone(void *arg) {
+  return ((BurstResult *)arg)->done;
+}
+
+/**
+ * A single sensor as fast as it goes, with the second bounce of every echo audible: ping_pingUs()
+ * back to back (what ping_ping() does), or one ping_burst() of BENCH_BURST pings. 'valid' samples
+ * are the ones within BENCH_VALID_SLACK of the target, the others heard a bounce.
+ */
+static void
+benchBurst(uint32_t distance, bool isBurst) {
+  static uint32_t results[BENCH_BURST];
+  Ping_Burst burst;
+  BurstResult burstResult = {false, 0};
+  uint32_t expected = echoTimeOf(distance);
+  uint32_t failures = 0;
+  uint32_t valid = 0;
+  uint64_t start = 0;
+  uint64_t elapsed = 0;
+  uint32_t i = 0;
+
+  setupSensors(1, false, distance, PING_MM);
+  sim_setReverberation(0, true);
+  start = sim_now();
+  if (isBurst) {
+    if (ping_burst(&burst, &sensors[0], BENCH_BURST, echoTimeOf(4000), results, burstCallback, &burstResult)) {
+      sim_runUntil(isBurstDone, &burstResult, BENCH_BURST * 2 * echoTimeOf(4000));
+    }
+  } else {
+    for (i=0; i<BENCH_BURST; i++) {
+      if (!ping_pingUs(&sensors[0], echoTimeOf(4000), &results[i])) {
+        results[i] = 0;
+      }
+    }
+  }
+  elapsed = sim_now() - start;
+  for (i=0; i<BENCH_BURST; i++) {
+    if (!results[i]) {
+      failures++;
+    } else if (results[i] + BENCH_VALID_SLACK >= expected && results[i] <= expected + BENCH_VALID_SLACK) {
+      valid++;
+    }
+  }
+  printf("{\"bench\":\"burst\",\"method\":\"%s\",\"distance_mm\":%u,\"samples\":%u,\"samples_per_sec\":%.1f,"
+         "\"valid_per_sec\":%.1f,\"cpu_busy\":%.4f,\"failure_rate\":%.4f}\n",
+         isBurst ? "ping_burst" : "ping_pingUs", distance, BENCH_BURST, BENCH_BURST * 1000000.0 / elapsed,
+         valid * 1000000.0 / elapsed, busyFraction(elapsed), (double)failures / BENCH_BURST);
+}
+
+typedef struct {
+  uint32_t samples;
+  uint32_t failures;
+  uint64_t lastSample[BENCH_MAX_SENSORS];
+  uint32_t intervals; // number of entries in 'times'
+} SchedulerResults;
+
+static void
+schedulerCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  SchedulerResults *results = (SchedulerResults *)arg;
+  uint8_t i = pingData - sensors;
+  results->samples++;
+  if (!success) {
+    results->failures++;
+  }
+  if (results->lastSample[i] && results->intervals < COUNT(times)) {
+    times[results->intervals++] = (uint32_t)(sim_now() - results->lastSample[i]);
+  }
+  results->lastSample[i] = sim_now();
+}
+
+/**
+ * The scheduler, with independent sensors (one fire group) or with every sensor hearing its
+ * neighbours (two fire groups).
+ */
+static void
+benchScheduler(uint8_t count, bool neighboursInterfere) {
+  static Ping_Scheduler scheduler;
+  static SchedulerResults results;
+  uint64_t elapsed = 0;
+  uint32_t p50 = 0;
+  uint32_t p99 = 0;
+  uint8_t i = 0;
+
+  memset(&results, 0, sizeof(results));
+  setupSensors(count, true, 1000, PING_MM);
+  ping_schedulerInit(&scheduler, echoTimeOf(4000), schedulerCallback, &results);
+  for (i=0; i<count; i++) {
+    ping_schedulerAdd(&scheduler, &sensors[i]);
+  }
+  for (i=0; neighboursInterfere && i+1<count; i++) {
+    ping_schedulerSetInterference(&scheduler, i, i+1, true);
+  }
+  ping_schedulerStart(&scheduler);
+  sim_run(BENCH_SCHEDULER_TIME);
+  elapsed = sim_now();
+  ping_schedulerStop(&scheduler);
+  sim_run(2*echoTimeOf(4000));
+
+  p50 = percentile(times, results.intervals, 50);
+  p99 = percentile(times, results.intervals, 99);
+  printf("{\"bench\":\"scheduler\",\"sensors\":%u,\"groups\":%u,\"samples\":%u,\"samples_per_sec\":%.1f,"
+         "\"cpu_busy\":%.4f,\"p50_interval_us\":%u,\"p99_interval_us\":%u,\"failure_rate\":%.4f}\n",
+         count, scheduler.numberOfGroups, results.samples, results.samples * 1000000.0 / elapsed,
+         busyFraction(elapsed), p50, p99, results.samples ? (double)results.failures / results.samples : 0);
+}
+
+/**
+ * What the interrupt handlers do per ping: register accesses and calls into the SDK, per GPIO
+ * (echo edge) and per FRC1 interrupt. The cycles the echo handler takes on the real thing are
+ * in ping_getBusyStats(), ping_latencyDump() prints them.
+ */
+static void
+benchIsr(bool isSinglePin) {
+  Sim_Stats stats;
+  uint32_t failures = 0;
+  uint32_t i = 0;
+  float result = 0;
+
+  setupSensors(1, isSinglePin, 1000, PING_MM);
+  sim_getStats(&stats, true);
+  for (i=0; i<BENCH_PINGS; i++) {
+    if (!ping_ping(&sensors[0], 4000, &result)) {
+      failures++;
+    }
+  }
+  sim_getStats(&stats, false);
+  printf("{\"bench\":\"isr\",\"mode\":\"%s\",\"samples\":%u,\"gpio_interrupts_per_ping\":%.2f,"
+         "\"gpio_register_reads\":%.2f,\"gpio_register_writes\":%.2f,\"gpio_sdk_calls\":%.2f,"
+         "\"timer_interrupts_per_ping\":%.2f,\"timer_register_reads\":%.2f,\"timer_register_writes\":%.2f,"
+         "\"timer_sdk_calls\":%.2f,\"failure_rate\":%.4f}\n",
+         isSinglePin ? "single_pin" : "two_pin", BENCH_PINGS, (double)stats.gpioInterrupts / BENCH_PINGS,
+         (double)stats.gpioIsr.registerReads / stats.gpioInterrupts,
+         (double)stats.gpioIsr.registerWrites / stats.gpioInterrupts,
+         (double)stats.gpioIsr.sdkCalls / stats.gpioInterrupts, (double)stats.timerInterrupts / BENCH_PINGS,
+         (double)stats.timerIsr.registerReads / stats.timerInterrupts,
+         (double)stats.timerIsr.registerWrites / stats.timerInterrupts,
+         (double)stats.timerIsr.sdkCalls / stats.timerInterrupts, (double)failures / BENCH_PINGS);
+}
+
+typedef enum {
+  TOGGLE_OUTPUT_SET = 0, // easygpio_outputSet(), pin by pin
+  TOGGLE_SDK,            // GPIO_OUTPUT_SET(), pin by pin
+  TOGGLE_MASK,           // easygpio_outputSetMask(), all the pins at once
+  READ_INPUT_GET,        // easygpio_inputGet(), pin by pin
+  READ_MASK,             // easygpio_inputGetMask(), all the pins at once
+  GPIO_METHODS
+} GpioMethod;
+
+static const char *gpioMethodNames[GPIO_METHODS] = {
+  "easygpio_outputSet", "GPIO_OUTPUT_SET", "easygpio_outputSetMask", "easygpio_inputGet", "easygpio_inputGetMask"
+};
+
+/**
+ * Register accesses per pin toggled (or read), the per pin calls against the mask calls.
+ * The time these take on the real thing is measured by driver/easygpio/examples/togglebench.
+ */
+static void
+benchGpio(GpioMethod method) {
+  Sim_Stats stats;
+  uint32_t mask = 0;
+  uint32_t sink = 0;
+  uint32_t i = 0;
+  uint8_t p = 0;
+
+  sim_init(0, 0);
+  for (p=0; p<COUNT(togglePins); p++) {
+    easygpio_pinMode(togglePins[p], EASYGPIO_NOPULL, EASYGPIO_OUTPUT);
+    mask |= BIT(togglePins[p]);
+  }
+  sim_getStats(&stats, true);
+  for (i=0; i<BENCH_TOGGLES; i++) {
+    uint8_t value = i & 1;
+    switch (method) {
+      case TOGGLE_OUTPUT_SET:
+        for (p=0; p<COUNT(togglePins); p++) {
+          easygpio_outputSet(togglePins[p], value);
+        }
+        break;
+      case TOGGLE_SDK:
+        for (p=0; p<COUNT(togglePins); p++) {
+          GPIO_OUTPUT_SET(togglePins[p], value);
+        }
+        break;
+      case TOGGLE_MASK:
+        easygpio_outputSetMask(value ? mask : 0, value ? 0 : mask);
+        break;
+      case READ_INPUT_GET:
+        for (p=0; p<COUNT(togglePins); p++) {
+          sink += easygpio_inputGet(togglePins[p]);
+        }
+        break;
+      default:
+        sink += easygpio_inputGetMask() & mask;
+        break;
+    }
+  }
+  sim_getStats(&stats, false);
+  (void)sink;
+  printf("{\"bench\":\"gpio\",\"method\":\"%s\",\"pins\":%u,\"register_reads_per_pin\":%.2f,"
+         "\"register_writes_per_pin\":%.2f}\n", gpioMethodNames[method], (unsigned)COUNT(togglePins),
+         (double)stats.registerReads / (BENCH_TOGGLES * COUNT(togglePins)),
+         (double)stats.registerWrites / (BENCH_TOGGLES * COUNT(togglePins)));
+}
+
+static double
+hostNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/**
+ * Host CPU cost of ping_filterUpdate() for every window size.
+ */
+static void
+benchFilter(void) {
+  Ping_Filter filter;
+  uint32_t filtered = 0;
+  uint32_t random = 1;
+  uint8_t window = 0;
+  uint32_t i = 0;
+
+  for (window=1; window<=PING_FILTER_MAX_WINDOW; window+=2) {
+    double start = 0;
+    ping_filterInit(&filter, window, 3, 10);
+    start = hostNow();
+    for (i=0; i<BENCH_HOST_LOOPS/10; i++) {
+      random = random * 1103515245 + 12345;
+      ping_filterUpdate(&filter, true, 1000 + ((random >> 16) & 0xff), &filtered);
+    }
+    printf("{\"bench\":\"filter\",\"window\":%u,\"update_ns\":%.2f}\n", window,
+           (hostNow() - start) / (BENCH_HOST_LOOPS/10));
+  }
+}
+
+int
+main(int argc, char **argv) {
+  bool hostTiming = argc > 1 && 0 == strcmp(argv[1], "-t");
+  uint8_t mode = 0;
+  uint8_t s = 0;
+  uint8_t d = 0;
+  uint8_t r = 0;
+  uint8_t u = 0;
+
+  for (mode=0; mode<2; mode++) {
+    for (s=0; s<COUNT(sensorCounts); s++) {
+      for (d=0; d<COUNT(distances); d++) {
+        for (r=0; r<COUNT(maxRanges); r++) {
+          for (u=0; u<2; u++) {
+            benchPing(sensorCounts[s], mode, distances[d], maxRanges[r], u ? PING_INCHES : PING_MM);
+          }
+        }
+      }
+    }
+  }
+  for (d=0; d<COUNT(distances); d++) {
+    benchBurst(distances[d], false);
+    benchBurst(distances[d], true);
+  }
+  for (s=0; s<COUNT(schedulerCounts); s++) {
+    benchScheduler(schedulerCounts[s], false);
+    benchScheduler(schedulerCounts[s], true);
+  }
+  benchIsr(false);
+  benchIsr(true);
+  for (u=0; u<GPIO_METHODS; u++) {
+    benchGpio(u);
+  }
+  if (hostTiming) {
+    benchFilter();
+  }
+  return 0;
+}
@@ -0,0 +1,990 @@
+/*
+* ping_sim.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+#include <math.h>
+#include "sim.h"
+#include "ping/ping.h"
+#include "ping/ping_filter.h"
+#include "ping/ping_tracker.h"
+#include "ping/ping_scheduler.h"
+#include "easygpio/easygpio.h"
+#include "gpio.h"
+#include "osapi.h"
+
+/**
+ * Runs the ping driver against scripted sensors on the simulated ESP8266 and checks the outcome
+ * of every ping. Exits with 1 if any ping didn't end the way the script says it should.
+ *
+ *   make -C host run
+ */
+
+#define TRIGGER_PIN 4
+#define ECHO_PIN 5
+#define SINGLE_PIN 12
+#define MAX_PERIOD 25000 // us, shorter than SIM_NO_ECHO_LENGTH
+#define OTHER_TRIGGER_PIN 13 // a pin used by some other driver
+#define OTHER_ECHO_PIN 14
+#define RING_SIZE 8 // PING_EVENT_RING_SIZE, see the Makefile: small enough for a few sensors to fill it
+
+typedef struct {
+  Ping_Status status;
+  uint32_t echoTime; // us, checked when status is PING_STATUS_OK
+} Expected;
+
+typedef struct {
+  const char *name;
+  uint32_t startTime;       // system_get_time() at the start
+  uint32_t startCycles;     // CCOUNT at the start
+  bool isSinglePin;
+  bool isAsync;
+  uint32_t isrCost;         // us per interrupt handler call
+  uint32_t blackoutPeriod;  // us, interrupts masked for blackoutLength us every blackoutPeriod us
+  uint32_t blackoutLength;
+  const Sim_Response *responses;
+  uint8_t responseCount;
+  const Expected *expected; // one per ping
+  uint8_t pings;
+} Scenario;
+
+#define COUNT(array) (sizeof(array)/sizeof(array[0]))
+#define SCRIPT(responses, expected) responses, COUNT(responses), expected, COUNT(expected)
+
+static const char *statusNames[PING_STATUS_COUNT] = {
+  "OK", "NO_ECHO", "ECHO_TOO_LONG", "STUCK_HIGH", "TOO_SHORT", "BUSY", "NOT_INITIATED"
+};
+
+static const Sim_Response echoes[] = {
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 5800, 0}, {SIM_ECHO, 580, 0}, {SIM_ECHO, 20000, 0}
+};
+static const Expected echoesExpected[] = {
+  {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 5800}, {PING_STATUS_OK, 580}, {PING_STATUS_OK, 20000}
+};
+
+static const Sim_Response failures[] = {
+  {SIM_SILENT, 0, 0}, {SIM_NO_ECHO, 0, 0}, {SIM_ECHO, 1160, 0}, {SIM_STUCK_HIGH, 0, 0},
+  {SIM_ECHO, 1160, 0}, {SIM_GHOST, 2000, 30}, {SIM_ECHO, 1160, 0}
+};
+// The no echo pulse outlasts the time out. The stuck sensor is noticed by the ping after the one
+// that got it stuck, that ping wakes it up instead of triggering it.
+static const Expected failuresExpected[] = {
+  {PING_STATUS_NO_ECHO, 0}, {PING_STATUS_ECHO_TOO_LONG, 0}, {PING_STATUS_OK, 1160},
+  {PING_STATUS_ECHO_TOO_LONG, 0}, {PING_STATUS_STUCK_HIGH, 0}, {PING_STATUS_OK, 1160},
+  {PING_STATUS_TOO_SHORT, 0}, {PING_STATUS_OK, 1160}
+};
+
+// Only a wake up pulse of 150 us or longer gets the sensor unstuck, the third one
+static const Sim_Response stuck[] = {
+  {SIM_ECHO, 1160, 0}, {SIM_STUCK_HIGH, 150, 0}, {SIM_ECHO, 1160, 0}
+};
+static const Expected stuckExpected[] = {
+  {PING_STATUS_OK, 1160}, {PING_STATUS_ECHO_TOO_LONG, 0}, {PING_STATUS_STUCK_HIGH, 0}, {PING_STATUS_OK, 1160}
+};
+
+static const Sim_Response wrap[] = {
+  {SIM_ECHO, 1160, 0}
+};
+static const Expected wrapExpected[] = {
+  {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160},
+  {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160}, {PING_STATUS_OK, 1160}
+};
+
+static const Scenario scenarios[] = {
+  {"echoes", 0, 0, false, false, 0, 0, 0, SCRIPT(echoes, echoesExpected)},
+  {"echoes async", 0, 0, false, true, 0, 0, 0, SCRIPT(echoes, echoesExpected)},
+  {"echoes single pin", 0, 0, true, false, 0, 0, 0, SCRIPT(echoes, echoesExpected)},
+  {"failures", 0, 0, false, false, 0, 0, 0, SCRIPT(failures, failuresExpected)},
+  {"failures async", 0, 0, false, true, 0, 0, 0, SCRIPT(failures, failuresExpected)},
+  {"failures single pin", 0, 0, true, true, 0, 0, 0, SCRIPT(failures, failuresExpected)},
+  {"stuck recovery", 0, 0, false, false, 0, 0, 0, SCRIPT(stuck, stuckExpected)},
+  {"stuck recovery single pin", 0, 0, true, true, 0, 0, 0, SCRIPT(stuck, stuckExpected)},
+  // both clocks wrap during the first few pings
+  {"clock wrap", 0xffffc000, 0xfff00000, false, false, 0, 0, 0, SCRIPT(wrap, wrapExpected)},
+  {"clock wrap async", 0xffffc000, 0xfff00000, false, true, 0, 0, 0, SCRIPT(wrap, wrapExpected)},
+  // slow interrupt handlers, and the WiFi stack masking interrupts 100us every ms
+  {"busy cpu", 0, 0, false, true, 5, 1000, 100, SCRIPT(echoes, echoesExpected)},
+};
+
+static const uint8_t cpuFreqs[] = {80, 160, 52};
+
+typedef struct {
+  bool done;
+  bool success;
+  uint32_t echoTime;
+} AsyncResult;
+
+static void
+asyncCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  AsyncResult *result = (AsyncResult *)arg;
+  result->done = true;
+  result->success = success;
+  result->echoTime = echoTime;
+}
+
+static bool
+isDone(void *arg) {
+  return ((AsyncResult *)arg)->done;
+}
+
+/**
+ * Echo times are measured between interrupt handler calls, so they are off by the interrupt latency.
+ */
+static bool
+isClose(uint32_t echoTime, uint32_t expected, uint32_t slack) {
+  return echoTime + slack >= expected && echoTime <= expected + slack;
+}
+
+static bool
+runScenario(const Scenario *scenario) {
+  Ping_Data pingData;
+  Ping_Stats stats;
+  Sim_Stats simStats;
+  uint32_t slack = scenario->isrCost + scenario->blackoutLength + 1;
+  uint64_t startTime = 0;
+  uint8_t failures = 0;
+  uint8_t i = 0;
+
+  sim_init(scenario->startTime, scenario->startCycles);
+  sim_setIsrCost(scenario->isrCost);
+  sim_setInterruptBlackout(scenario->blackoutPeriod, scenario->blackoutLength);
+  if (scenario->isSinglePin) {
+    sim_addSensor(SINGLE_PIN, SINGLE_PIN, scenario->responses, scenario->responseCount, true);
+    ping_initOnePinMode(&pingData, SINGLE_PIN, PING_MM);
+  } else {
+    sim_addSensor(TRIGGER_PIN, ECHO_PIN, scenario->responses, scenario->responseCount, true);
+    ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  }
+
+  printf("%s:\n", scenario->name);
+  startTime = sim_now();
+  for (i=0; i<scenario->pings; i++) {
+    const Expected *expected = &scenario->expected[i];
+    uint32_t echoTime = 0;
+    bool success = false;
+    bool ok = false;
+
+    if (scenario->isAsync) {
+      AsyncResult result = {false, false, 0};
+      if (ping_startAsync(&pingData, MAX_PERIOD, asyncCallback, &result)) {
+        sim_runUntil(isDone, &result, 2*MAX_PERIOD);
+      }
+      success = result.success;
+      echoTime = result.echoTime;
+    } else {
+      success = ping_pingUs(&pingData, MAX_PERIOD, &echoTime);
+    }
+
+    ok = ping_getStatus(&pingData) == expected->status && success == (PING_STATUS_OK == expected->status);
+    if (success) {
+      ok = ok && isClose(echoTime, expected->echoTime, slack);
+    }
+    if (!ok) {
+      failures++;
+    }
+    printf("  ping %u: %-13s %6u us, expected %-13s %s\n", i, statusNames[ping_getStatus(&pingData)],
+           success ? echoTime : 0, statusNames[expected->status], ok ? "ok" : "FAILED");
+
+    // let the sensor calm down, as a real application would
+    sim_run(10000);
+  }
+
+  ping_getStats(&pingData, &stats, false);
+  sim_getStats(&simStats, false);
+  printf("  %u pings in %llu us, min/mean/max echo %u/%u/%u us, %u spurious interrupts\n",
+         scenario->pings, (unsigned long long)(sim_now() - startTime),
+         stats.outcomes[PING_STATUS_OK] ? stats.minEchoTime : 0, stats.meanEchoTime, stats.maxEchoTime,
+         stats.spuriousInterrupts);
+  printf("  %u gpio + %u timer interrupts (max latency %u us), %u tasks, %u us busy waiting\n",
+         simStats.gpioInterrupts, simStats.timerInterrupts, simStats.latencyMax, simStats.tasks,
+         simStats.delayTime);
+  return 0 == failures;
+}
+
+static void
+countEdges(void *arg) {
+  (*(uint32_t *)arg)++;
+}
+
+/**
+ * Another driver attaches its own GPIO interrupt handler while the pings are running,
+ * both must see their edges.
+ */
+static bool
+runSharedInterrupts(void) {
+  static const Sim_Response response = {SIM_ECHO, 1160, 0};
+  Ping_Data pingData;
+  uint32_t otherEdges = 0;
+  uint32_t echoTime = 0;
+  uint8_t successes = 0;
+  uint8_t i = 0;
+  bool ok = false;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, &response, 1, true);
+  sim_addSensor(OTHER_TRIGGER_PIN, OTHER_ECHO_PIN, &response, 1, true);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  easygpio_pinMode(OTHER_TRIGGER_PIN, EASYGPIO_NOPULL, EASYGPIO_OUTPUT);
+  easygpio_attachInterrupt(OTHER_ECHO_PIN, EASYGPIO_NOPULL, countEdges, &otherEdges);
+  gpio_pin_intr_state_set(GPIO_ID_PIN(OTHER_ECHO_PIN), GPIO_PIN_INTR_ANYEDGE);
+
+  for (i=0; i<4; i++) {
+    // the other driver triggers its sensor, the echo ends during the ping
+    easygpio_outputSet(OTHER_TRIGGER_PIN, 1);
+    os_delay_us(10);
+    easygpio_outputSet(OTHER_TRIGGER_PIN, 0);
+    if (ping_pingUs(&pingData, MAX_PERIOD, &echoTime) && isClose(echoTime, 1160, 1)) {
+      successes++;
+    }
+    sim_run(10000);
+  }
+  easygpio_detachInterrupt(OTHER_ECHO_PIN);
+
+  ok = 4 == successes && 8 == otherEdges;
+  printf("shared interrupts:\n  %u of 4 pings ok, %u of 8 edges seen by the other handler %s\n",
+         successes, otherEdges, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+/**
+ * Two Ping_Data on the same sensor: while one of them pings, the other one can't start, and
+ * ping_getStatus() must say so instead of returning the outcome of its previous ping.
+ */
+static bool
+runBusy(void) {
+  static const Sim_Response response = {SIM_ECHO, 1160, 0};
+  Ping_Data first;
+  Ping_Data second;
+  Ping_Stats stats;
+  AsyncResult result = {false, false, 0};
+  uint32_t echoTime = 0;
+  Ping_Status asyncStatus = PING_STATUS_OK;
+  Ping_Status syncStatus = PING_STATUS_OK;
+  bool ok = false;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, &response, 1, true);
+  ping_init(&first, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  ping_init(&second, TRIGGER_PIN, ECHO_PIN, PING_MM);
+
+  ok = ping_pingUs(&second, MAX_PERIOD, &echoTime) && ping_startAsync(&first, MAX_PERIOD, asyncCallback, &result);
+  ok = ok && !ping_startAsync(&second, MAX_PERIOD, asyncCallback, &result);
+  asyncStatus = ping_getStatus(&second);
+  ok = ok && !ping_pingUs(&second, MAX_PERIOD, &echoTime);
+  syncStatus = ping_getStatus(&second);
+  ok = ok && sim_runUntil(isDone, &result, 2*MAX_PERIOD) && result.success;
+  ping_getStats(&second, &stats, false);
+  ok = ok && PING_STATUS_BUSY == asyncStatus && PING_STATUS_BUSY == syncStatus && 2 == stats.outcomes[PING_STATUS_BUSY];
+  printf("busy:\n  %s after ping_startAsync(), %s after ping_pingUs(), %u counted %s\n", statusNames[asyncStatus],
+         statusNames[syncStatus], stats.outcomes[PING_STATUS_BUSY], ok ? "ok" : "FAILED");
+  return ok;
+}
+
+#define OVERFLOW_SENSORS 6
+
+// single pin sensors, each ping adds a rising and a falling edge to the event ring
+static const uint8_t overflowPins[OVERFLOW_SENSORS] = {4, 5, 12, 13, 14, 15};
+
+typedef struct {
+  Ping_Data pingData[OVERFLOW_SENSORS];
+  AsyncResult results[OVERFLOW_SENSORS];
+  uint8_t count; // sensors pinged in this round
+} OverflowSensors;
+
+static bool
+allDone(void *arg) {
+  OverflowSensors *sensors = (OverflowSensors *)arg;
+  uint8_t i = 0;
+  for (i=0; i<sensors->count; i++) {
+    if (!sensors->results[i].done) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Starts a ping on the first 'count' sensors at once. Unless 'isDraining', busy waits (no task
+ * runs, nothing drains the event ring) until the echoes are over, then lets the ping task finish
+ * them. Returns the number of pings that ended with 'status', with the echo time checked for the
+ * successful ones.
+ */
+static uint8_t
+overflowRound(OverflowSensors *sensors, uint8_t count, bool isDraining, Ping_Status status) {
+  uint8_t matches = 0;
+  uint8_t i = 0;
+
+  sensors->count = count;
+  for (i=0; i<count; i++) {
+    sensors->results[i].done = false;
+    if (!ping_startAsync(&sensors->pingData[i], MAX_PERIOD, asyncCallback, &sensors->results[i])) {
+      sensors->results[i].done = true;
+    }
+  }
+  if (!isDraining) {
+    os_delay_us(3000);
+  }
+  sim_runUntil(allDone, sensors, 2*MAX_PERIOD);
+  for (i=0; i<count; i++) {
+    if (ping_getStatus(&sensors->pingData[i]) == status && sensors->results[i].done &&
+        (PING_STATUS_OK != status || isClose(sensors->results[i].echoTime, 1160, 1))) {
+      matches++;
+    }
+  }
+  sim_run(10000);
+  return matches;
+}
+
+/**
+ * Fills the event ring with real echo edges while nothing drains it. The edges that fit must
+ * all be processed, exactly the ones beyond RING_SIZE are dropped, the pings that lost an edge
+ * fail rather than hang, and the same pings work once the ping task keeps up again.
+ */
+static bool
+runEventOverflow(void) {
+  static const Sim_Response response = {SIM_ECHO, 1160, 0};
+  OverflowSensors sensors;
+  uint32_t overflows = 0;
+  uint8_t full = 0;
+  uint8_t survivors = 0;
+  uint8_t lost = 0;
+  uint8_t recovered = 0;
+  uint8_t i = 0;
+  bool ok = false;
+
+  sim_init(0, 0);
+  for (i=0; i<OVERFLOW_SENSORS; i++) {
+    sim_addSensor(overflowPins[i], overflowPins[i], &response, 1, true);
+    ping_initOnePinMode(&sensors.pingData[i], overflowPins[i], PING_MM);
+  }
+  overflows = ping_getEventOverflows();
+
+  // four pings, eight edges, exactly filling the ring
+  full = overflowRound(&sensors, RING_SIZE/2, false, PING_STATUS_OK);
+  ok = RING_SIZE/2 == full && ping_getEventOverflows() == overflows;
+
+  // six pings: the six rising edges fit, then only two of the falling edges
+  survivors = overflowRound(&sensors, OVERFLOW_SENSORS, false, PING_STATUS_OK);
+  lost = OVERFLOW_SENSORS - survivors;
+  ok = ok && RING_SIZE/2 - 2 == survivors &&
+       ping_getEventOverflows() - overflows == 2*OVERFLOW_SENSORS - RING_SIZE;
+  for (i=0; i<OVERFLOW_SENSORS; i++) {
+    Ping_Status status = ping_getStatus(&sensors.pingData[i]);
+    ok = ok && (PING_STATUS_OK == status || PING_STATUS_NO_ECHO == status || PING_STATUS_ECHO_TOO_LONG == status);
+  }
+
+  // the same six pings with the ping task running
+  recovered = overflowRound(&sensors, OVERFLOW_SENSORS, true, PING_STATUS_OK);
+  ok = ok && OVERFLOW_SENSORS == recovered &&
+       ping_getEventOverflows() - overflows == 2*OVERFLOW_SENSORS - RING_SIZE;
+
+  printf("event ring overflow:\n  ring filled to the brim: %u of %u pings ok\n"
+         "  %u edges too many: %u of %u pings failed, %u overflows\n"
+         "  draining as they come: %u of %u pings ok, %s\n",
+         full, RING_SIZE/2, 2*OVERFLOW_SENSORS - RING_SIZE, lost, OVERFLOW_SENSORS,
+         ping_getEventOverflows() - overflows, recovered, OVERFLOW_SENSORS, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+#define FILTER_WINDOW 7
+
+// Seven pings at 20 cm, an outlier, two more, then the target steps to 40 cm
+static const Sim_Response filterSteps[] = {
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0},
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 5800, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0},
+  {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0},
+  {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}
+};
+// The outlier is gated out. The first FILTER_WINDOW/2 samples of the step are too, then the
+// step is let through until it holds the majority of the window and the median follows.
+static const struct {
+  bool rejected;
+  uint32_t filtered;
+} filterExpected[] = {
+  {false, 1160}, {false, 1160}, {false, 1160}, {false, 1160}, {false, 1160}, {false, 1160}, {false, 1160},
+  {true, 1160}, {false, 1160}, {false, 1160},
+  {true, 1160}, {true, 1160}, {true, 1160}, {false, 1160}, {false, 1160}, {false, 1160}, {false, 2320},
+  {false, 2320}
+};
+
+/**
+ * Real pings fed through ping_filter.c with the median/MAD gate on.
+ */
+static bool
+runFilter(void) {
+  Ping_Data pingData;
+  Ping_Filter filter;
+  uint32_t failures = 0;
+  uint8_t i = 0;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, filterSteps, COUNT(filterSteps), false);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  ping_filterInit(&filter, FILTER_WINDOW, 3, 20);
+
+  printf("median filter:\n");
+  for (i=0; i<COUNT(filterSteps); i++) {
+    uint32_t echoTime = 0;
+    uint32_t filtered = 0;
+    uint32_t rejected = filter.rejected;
+    bool success = ping_pingUs(&pingData, MAX_PERIOD, &echoTime);
+    bool ok = ping_filterUpdate(&filter, success, echoTime, &filtered) && success &&
+              (filter.rejected != rejected) == filterExpected[i].rejected &&
+              isClose(filtered, filterExpected[i].filtered, 1);
+    if (!ok) {
+      failures++;
+    }
+    printf("  ping %u: %5u us -> %-8s median %5u us, expected %-8s %5u us %s\n", i, echoTime,
+           filter.rejected != rejected ? "rejected" : "accepted", filtered,
+           filterExpected[i].rejected ? "rejected" : "accepted", filterExpected[i].filtered, ok ? "ok" : "FAILED");
+    sim_run(10000);
+  }
+  return 0 == failures && 4 == filter.rejected;
+}
+
+#define TRACKER_MAX_MISSES 3
+
+// A still target at 20 cm that disappears for four pings
+static const Sim_Response trackerSteps[] = {
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0},
+  {SIM_SILENT, 0, 0}, {SIM_SILENT, 0, 0}, {SIM_SILENT, 0, 0}, {SIM_SILENT, 0, 0},
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}
+};
+// The time out is narrowed once two samples have locked the track, and widened by every miss.
+// The track coasts through TRACKER_MAX_MISSES misses and is dropped on the next one.
+static const struct {
+  bool narrowed;   // the ping ran with a time out below MAX_PERIOD
+  bool hasTrack;   // ping_trackerGet() after the ping
+} trackerExpected[] = {
+  {false, true}, {false, true}, {true, true}, {true, true},
+  {true, true}, {true, true}, {true, true}, {true, false},
+  {false, true}, {false, true}, {true, true}
+};
+
+/**
+ * Real pings with a ping_tracker.c tracker attached to the sensor.
+ */
+static bool
+runTracker(void) {
+  Ping_Data pingData;
+  Ping_Tracker tracker;
+  uint32_t lastTimeout = 0;
+  bool lastMissed = false;
+  uint32_t failures = 0;
+  uint8_t i = 0;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, trackerSteps, COUNT(trackerSteps), false);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  // search 5 cm around the prediction
+  ping_trackerInit(&tracker, &pingData, PING_TRACKER_ONE/2, PING_TRACKER_ONE/4, 500, TRACKER_MAX_MISSES);
+
+  printf("tracker:\n");
+  for (i=0; i<COUNT(trackerSteps); i++) {
+    int32_t distance = 0;
+    int32_t velocity = 0;
+    uint32_t echoTime = 0;
+    bool success = ping_pingUs(&pingData, MAX_PERIOD, &echoTime);
+    bool narrowed = pingData.timeout < MAX_PERIOD;
+    bool hasTrack = ping_trackerGet(&tracker, &distance, &velocity);
+    bool ok = success == (SIM_ECHO == trackerSteps[i].type) && narrowed == trackerExpected[i].narrowed &&
+              hasTrack == trackerExpected[i].hasTrack;
+    if (lastMissed && narrowed) {
+      // coasting, every miss searches further
+      ok = ok && pingData.timeout > lastTimeout;
+    }
+    if (!ok) {
+      failures++;
+    }
+    printf("  ping %2u: %-7s time out %5u us, %s, expected %s %s %s\n", i, statusNames[ping_getStatus(&pingData)],
+           pingData.timeout, hasTrack ? "track" : "no track", trackerExpected[i].narrowed ? "narrowed" : "full",
+           trackerExpected[i].hasTrack ? "track" : "no track", ok ? "ok" : "FAILED");
+    lastTimeout = pingData.timeout;
+    lastMissed = !success;
+    sim_run(10000);
+  }
+  ping_trackerDetach(&pingData);
+  return 0 == failures && 1 == tracker.lost;
+}
+
+#define ADAPTIVE_PINGS 40
+#define ADAPTIVE_MISS 30 // the one ping that gets no echo
+#define ADAPTIVE_TIMEOUT (1160 + 1160/4 + 1000) // the longest echo, plus 1/4, plus PING_ADAPTIVE_MARGIN
+
+/**
+ * Returns true if ping 'i' of runAdaptive() should use the full time out: the first 8 (half a
+ * PING_ADAPTIVE_BLOCK, the history is too short), every 17th after that (PING_ADAPTIVE_PROBE_INTERVAL
+ * shortened pings, then a probe of the full range) and the one after the miss.
+ */
+static bool
+isAdaptiveProbe(uint8_t i) {
+  return i < 8 || i == 24 || i == ADAPTIVE_MISS + 1;
+}
+
+/**
+ * Real pings with the adaptive time out on, at a still target with one missed echo.
+ */
+static bool
+runAdaptive(void) {
+  static Sim_Response responses[ADAPTIVE_PINGS];
+  Ping_Data pingData;
+  uint32_t shortenedTimeouts = 0;
+  uint32_t savedTime = 0;
+  uint32_t failures = 0;
+  uint8_t shortened = 0;
+  uint8_t i = 0;
+  bool ok = false;
+
+  for (i=0; i<ADAPTIVE_PINGS; i++) {
+    responses[i].type = ADAPTIVE_MISS == i ? SIM_SILENT : SIM_ECHO;
+    responses[i].echoTime = 1160;
+  }
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, responses, ADAPTIVE_PINGS, false);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  ping_setAdaptiveTimeout(&pingData, true);
+
+  printf("adaptive time out:\n  full time out on ping");
+  for (i=0; i<ADAPTIVE_PINGS; i++) {
+    uint32_t echoTime = 0;
+    bool success = ping_pingUs(&pingData, MAX_PERIOD, &echoTime);
+    bool isFull = MAX_PERIOD == pingData.timeout;
+    bool pingOk = success == (ADAPTIVE_MISS != i) && isFull == isAdaptiveProbe(i) &&
+                  (isFull || isClose(pingData.timeout, ADAPTIVE_TIMEOUT, 2));
+    if (isFull) {
+      printf(" %u", i);
+    } else {
+      shortened++;
+    }
+    if (!pingOk) {
+      printf("(FAILED)");
+      failures++;
+    }
+    sim_run(10000);
+  }
+  ping_getAdaptiveStats(&pingData, &shortenedTimeouts, &savedTime, false);
+  // only the missed echo was cut short, the others would have come back in time anyway
+  ok = 0 == failures && 1 == shortenedTimeouts && isClose(savedTime, MAX_PERIOD - ADAPTIVE_TIMEOUT, 2);
+  printf("\n  %u of %u pings shortened, %u timed out early, saving %u us (expected %u) %s\n",
+         shortened, ADAPTIVE_PINGS, shortenedTimeouts, savedTime, MAX_PERIOD - ADAPTIVE_TIMEOUT, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// a target that moves, with one missed echo, heard by a sensor that also hears the second bounce
+static const Sim_Response burstSteps[] = {
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 1160, 0}, {SIM_ECHO, 5800, 0}, {SIM_ECHO, 580, 0},
+  {SIM_SILENT, 0, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 1160, 0}
+};
+
+typedef struct {
+  bool done;
+  uint8_t successes;
+} BurstResult;
+
+static void
+burstCallback(Ping_Data *pingData, uint8_t successes, uint32_t results[], void *arg) {
+  BurstResult *result = (BurstResult *)arg;
+  result->done = true;
+  result->successes = successes;
+}
+
+static bool
+isBurstDone(void *arg) {
+  return ((BurstResult *)arg)->done;
+}
+
+/**
+ * One ping_burst() through burstSteps. Every ping must wait out the second bounce of the one
+ * before it, a ping that goes out too early hears the bounce and gets a short echo time.
+ */
+static bool
+runBurst(void) {
+  uint32_t results[COUNT(burstSteps)];
+  Ping_Burst burst;
+  BurstResult burstResult = {false, 0};
+  Ping_Data pingData;
+  uint8_t failures = 0;
+  uint8_t i = 0;
+
+  sim_init(0, 0);
+  sim_setReverberation(sim_addSensor(TRIGGER_PIN, ECHO_PIN, burstSteps, COUNT(burstSteps), false), true);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+
+  printf("burst:\n");
+  if (!ping_burst(&burst, &pingData, COUNT(burstSteps), MAX_PERIOD, results, burstCallback, &burstResult) ||
+      !sim_runUntil(isBurstDone, &burstResult, 1000000)) {
+    printf("  didn't complete FAILED\n");
+    return false;
+  }
+  for (i=0; i<COUNT(burstSteps); i++) {
+    bool ok = isClose(results[i], burstSteps[i].echoTime, 2);
+    if (!ok) {
+      failures++;
+    }
+    printf("  ping %u: %5u us, expected %5u us %s\n", i, results[i], burstSteps[i].echoTime, ok ? "ok" : "FAILED");
+  }
+  return 0 == failures && COUNT(burstSteps) - 1 == burstResult.successes;
+}
+
+#define LEARN_SENSORS 3
+#define LEARN_CROSSTALK 600 // us from the burst of sensor 0 to sensor 1 and back, shorter than both echoes
+#define LEARN_ROUNDS 6 // fire group rounds checked after learning
+
+static const Sim_Response learnResponses[LEARN_SENSORS] = {
+  {SIM_ECHO, 1160, 0}, {SIM_ECHO, 2320, 0}, {SIM_ECHO, 1740, 0}
+};
+
+typedef struct {
+  Ping_Data pingData[LEARN_SENSORS];
+  Ping_Scheduler scheduler;
+  uint32_t samples;
+  uint32_t wrong; // results that aren't the echo of the sensor's own target
+} LearnSensors;
+
+static void
+learnCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  LearnSensors *sensors = (LearnSensors *)arg;
+  sensors->samples++;
+  if (!success || !isClose(echoTime, learnResponses[pingData - sensors->pingData].echoTime, 1)) {
+    sensors->wrong++;
+  }
+}
+
+static bool
+isLearned(void *arg) {
+  return PING_SCHEDULER_RUNNING == ((LearnSensors *)arg)->scheduler.state;
+}
+
+static bool
+hasSampled(void *arg) {
+  LearnSensors *sensors = (LearnSensors *)arg;
+  return sensors->samples >= LEARN_ROUNDS*LEARN_SENSORS/2;
+}
+
+/**
+ * ping_schedulerLearn() with sensors 0 and 1 hearing each other and sensor 2 on its own. Only
+ * the pair 0-1 may be marked, the fire groups must keep 0 and 1 apart, and the results delivered
+ * once the scheduler runs must all be the real echoes.
+ */
+static bool
+runSchedulerLearn(void) {
+  static LearnSensors sensors;
+  uint16_t together = 0;
+  uint16_t grouped = 0;
+  uint8_t i = 0;
+  bool ok = false;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, &learnResponses[0], 1, true);
+  sim_addSensor(OTHER_TRIGGER_PIN, OTHER_ECHO_PIN, &learnResponses[1], 1, true);
+  sim_addSensor(SINGLE_PIN, SINGLE_PIN, &learnResponses[2], 1, true);
+  sim_setCrosstalk(0, 1, LEARN_CROSSTALK);
+  ping_init(&sensors.pingData[0], TRIGGER_PIN, ECHO_PIN, PING_MM);
+  ping_init(&sensors.pingData[1], OTHER_TRIGGER_PIN, OTHER_ECHO_PIN, PING_MM);
+  ping_initOnePinMode(&sensors.pingData[2], SINGLE_PIN, PING_MM);
+  ping_schedulerInit(&sensors.scheduler, MAX_PERIOD, learnCallback, &sensors);
+  for (i=0; i<LEARN_SENSORS; i++) {
+    ping_schedulerAdd(&sensors.scheduler, &sensors.pingData[i]);
+  }
+  sensors.samples = 0;
+  sensors.wrong = 0;
+
+  ok = ping_schedulerLearn(&sensors.scheduler) && sim_runUntil(isLearned, &sensors, 1000000) &&
+       0 == sensors.samples;
+  ok = ok && BIT(1) == sensors.scheduler.interference[0] && BIT(0) == sensors.scheduler.interference[1] &&
+       0 == sensors.scheduler.interference[2];
+  for (i=0; i<sensors.scheduler.numberOfGroups; i++) {
+    uint16_t group = sensors.scheduler.groups[i];
+    if ((group & BIT(0)) && (group & BIT(1))) {
+      together++;
+    }
+    grouped |= group;
+  }
+  ok = ok && 0 == together && BIT(LEARN_SENSORS) - 1 == grouped;
+
+  ok = ok && sim_runUntil(hasSampled, &sensors, 1000000) && 0 == sensors.wrong;
+  ping_schedulerStop(&sensors.scheduler);
+  sim_run(2*MAX_PERIOD);
+
+  printf("scheduler learning:\n  interference 0x%x 0x%x 0x%x (expected 0x2 0x1 0x0), %u fire groups, "
+         "%u with both 0 and 1\n  %u samples, %u wrong %s\n",
+         sensors.scheduler.interference[0], sensors.scheduler.interference[1], sensors.scheduler.interference[2],
+         sensors.scheduler.numberOfGroups, together, sensors.samples, sensors.wrong, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+#define AMBIENT_ECHO 20000 // us, long enough to show a 0.01% error in 1/10 mm
+
+/**
+ * The speed of sound (mm/s) in dry air at 'celsius', the formula the compile time table of
+ * ping.c approximates.
+ */
+static double
+referenceSoundSpeed(double celsius) {
+  return 331300.0 * sqrt(1.0 + celsius/273.15);
+}
+
+/**
+ * Returns true if 'echoTime' us converts to the distance the reference speed of sound at 'celsius'
+ * gives, within 0.05% (the table) plus a 1/10 mm (the rounding).
+ */
+static bool
+isReferenceTenthMm(Ping_Data *pingData, uint32_t echoTime, double celsius) {
+  double expected = echoTime * referenceSoundSpeed(celsius) / 200000.0;
+  uint32_t tenthMm = ping_usToTenthMm(pingData, echoTime);
+  bool ok = fabs(tenthMm - expected) <= expected*0.0005 + 1.0;
+  printf("  %5.1f C: %u us is %u 1/10 mm, expected %.1f %s\n", celsius, echoTime, tenthMm, expected, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+/**
+ * ping_setAmbient(): the table against the reference formula at both ends and in the middle,
+ * clamping of the temperature and humidity, a global and a per sensor setting.
+ */
+static bool
+runAmbient(void) {
+  Ping_Data pingData;
+  Ping_Data other;
+  uint32_t atMin = 0;
+  uint32_t atMax = 0;
+  uint32_t humid = 0;
+  uint32_t cold = 0;
+  uint32_t warm = 0;
+  bool ok = true;
+
+  sim_init(0, 0);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+  ping_init(&other, OTHER_TRIGGER_PIN, OTHER_ECHO_PIN, PING_MM);
+
+  printf("ambient:\n");
+  ping_setAmbient(&pingData, PING_MIN_CELSIUS, 0);
+  ok = isReferenceTenthMm(&pingData, AMBIENT_ECHO, PING_MIN_CELSIUS) && ok;
+  atMin = ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+  ping_setAmbient(&pingData, 22, 0);
+  ok = isReferenceTenthMm(&pingData, AMBIENT_ECHO, 22) && ok;
+  ping_setAmbient(&pingData, PING_MAX_CELSIUS, 0);
+  ok = isReferenceTenthMm(&pingData, AMBIENT_ECHO, PING_MAX_CELSIUS) && ok;
+  atMax = ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+
+  // out of range temperatures and humidities are clamped
+  ping_setAmbient(&pingData, PING_MIN_CELSIUS - 20, 0);
+  ok = ok && atMin == ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+  ping_setAmbient(&pingData, PING_MAX_CELSIUS + 40, 0);
+  ok = ok && atMax == ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+  ping_setAmbient(&pingData, 20, 100);
+  humid = ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+  ping_setAmbient(&pingData, 20, 250);
+  ok = ok && humid == ping_usToTenthMm(&pingData, AMBIENT_ECHO);
+  printf("  clamped to %d and %d C, and to 100%% RH %s\n", PING_MIN_CELSIUS, PING_MAX_CELSIUS, ok ? "ok" : "FAILED");
+
+  // the same echo is further away in warm air, 'other' follows the global setting
+  ping_setAmbient(&pingData, PING_AMBIENT_UNSET, 0);
+  ping_setAmbient(NULL, 0, 0);
+  cold = ping_usToMm(&other, 5800);
+  ping_setAmbient(NULL, 30, 0);
+  warm = ping_usToMm(&other, 5800);
+  ok = ok && fabs(cold - 5800*referenceSoundSpeed(0)/2000000.0) <= 1.0 &&
+       fabs(warm - 5800*referenceSoundSpeed(30)/2000000.0) <= 1.0 && ping_usToMm(&pingData, 5800) == warm;
+  ping_setAmbient(&pingData, 0, 0);
+  ok = ok && ping_usToMm(&pingData, 5800) == cold && ping_usToMm(&other, 5800) == warm;
+  printf("  5800 us is %u mm at 0 C and %u mm at 30 C", cold, warm);
+
+  // back to PING_US_TO_MM
+  ping_setAmbient(NULL, PING_AMBIENT_UNSET, 0);
+  ping_setAmbient(&pingData, PING_AMBIENT_UNSET, 0);
+  ok = ok && 1000 == ping_usToMm(&pingData, 5800) && 1000 == ping_usToMm(&other, 5800);
+  printf(", %u mm unset %s\n", ping_usToMm(&pingData, 5800), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+#define FIXED_RANGE 4200 // mm, the maximum distance of the pings, past the longest echo
+
+// every echo time three times: ping_ping(), ping_pingMm() and ping_pingTenthMm()
+static const Sim_Response fixedEchoes[] = {
+  {SIM_ECHO, 580, 0}, {SIM_ECHO, 580, 0}, {SIM_ECHO, 580, 0},
+  {SIM_ECHO, 1163, 0}, {SIM_ECHO, 1163, 0}, {SIM_ECHO, 1163, 0},
+  {SIM_ECHO, 5800, 0}, {SIM_ECHO, 5800, 0}, {SIM_ECHO, 5800, 0},
+  {SIM_ECHO, 23197, 0}, {SIM_ECHO, 23197, 0}, {SIM_ECHO, 23197, 0}
+};
+
+/**
+ * Pings every echo of fixedEchoes through the float and the two fixed point functions, the
+ * fixed point distances must be the float distance rounded up or down.
+ */
+static uint8_t
+fixedPointPings(Ping_Data *pingData, const char *ambient) {
+  uint8_t failures = 0;
+  uint8_t i = 0;
+
+  sim_setResponses(0, fixedEchoes, COUNT(fixedEchoes), false);
+  for (i=0; i<COUNT(fixedEchoes); i+=3) {
+    float distance = 0;
+    uint32_t mm = 0;
+    uint32_t tenthMm = 0;
+    bool ok = ping_ping(pingData, FIXED_RANGE, &distance);
+    sim_run(10000);
+    ok = ping_pingMm(pingData, FIXED_RANGE, &mm) && ok;
+    sim_run(10000);
+    ok = ping_pingTenthMm(pingData, FIXED_RANGE*10, &tenthMm) && ok;
+    sim_run(10000);
+    ok = ok && fabs(mm - distance) < 1.0 && fabs(tenthMm - distance*10) < 1.0;
+    if (!ok) {
+      failures++;
+    }
+    printf("  %s %5u us: %8.3f mm, %4u mm, %5u 1/10 mm %s\n", ambient, fixedEchoes[i].echoTime, distance, mm,
+           tenthMm, ok ? "ok" : "FAILED");
+  }
+  return failures;
+}
+
+/**
+ * ping_pingMm(), ping_pingTenthMm() and the integer conversions against ping_ping(), at the default
+ * speed of sound and in warm humid air, the PING_MAX_TENTH_MM clamp and round trips.
+ */
+static bool
+runFixedPoint(void) {
+  static const uint32_t roundTrips[] = {580, 1163, 5800, 23197, 58000};
+  Ping_Data pingData;
+  uint32_t longest = 0;
+  uint32_t mm = 0;
+  uint8_t failures = 0;
+  uint8_t i = 0;
+  bool ok = false;
+
+  sim_init(0, 0);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, fixedEchoes, COUNT(fixedEchoes), false);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+
+  printf("fixed point:\n");
+  failures += fixedPointPings(&pingData, "default");
+  ping_setAmbient(&pingData, 30, 50);
+  failures += fixedPointPings(&pingData, "30C 50%");
+  ping_setAmbient(&pingData, PING_AMBIENT_UNSET, 0);
+
+  // 10 m is 58000 us, anything further is clamped
+  longest = ping_tenthMmToUs(&pingData, PING_MAX_TENTH_MM);
+  ok = isClose(longest, 58000, 1) && longest == ping_tenthMmToUs(&pingData, PING_MAX_TENTH_MM + 1) &&
+       longest == ping_tenthMmToUs(&pingData, 0xFFFFFFFF);
+  // maxDistance*10 would wrap to 4 (1/10 mm), a time out too short for any echo
+  sim_setResponses(0, &fixedEchoes[6], 1, false);
+  ok = ping_pingMm(&pingData, 0xFFFFFFFF/10 + 1, &mm) && 1000 == mm && ok;
+  sim_run(10000);
+  printf("  %u us at %u 1/10 mm and beyond, a %u mm maximum distance pings %u mm %s\n", longest, PING_MAX_TENTH_MM,
+         0xFFFFFFFF/10 + 1, mm, ok ? "ok" : "FAILED");
+
+  for (i=0; i<COUNT(roundTrips); i++) {
+    uint32_t tenthMm = ping_usToTenthMm(&pingData, roundTrips[i]);
+    uint32_t echoTime = ping_tenthMmToUs(&pingData, tenthMm);
+    bool tripOk = isClose(echoTime, roundTrips[i], 1);
+    ok = ok && tripOk;
+    printf("  %5u us -> %6u 1/10 mm -> %5u us %s\n", roundTrips[i], tenthMm, echoTime, tripOk ? "ok" : "FAILED");
+  }
+  return ok && 0 == failures;
+}
+
+/**
+ * ping_pingNs() at a CPU clock of 'cpuFreq' MHz, with CCOUNT wrapping in the middle of the first
+ * echo. The echo edges fall on whole microseconds, so the results must be exact.
+ */
+static bool
+runNanoseconds(uint8_t cpuFreq) {
+  Ping_Data pingData;
+  uint32_t ns = 0;
+  uint8_t failures = 0;
+  uint8_t i = 0;
+
+  // CCOUNT wraps 1000 us in, the first echo lasts from about 460 to 1620 us
+  sim_init(0, 0U - 1000U*cpuFreq);
+  sim_setCpuFreq(cpuFreq);
+  sim_addSensor(TRIGGER_PIN, ECHO_PIN, echoes, COUNT(echoes), true);
+  ping_init(&pingData, TRIGGER_PIN, ECHO_PIN, PING_MM);
+
+  printf("nanoseconds at %u MHz:\n", cpuFreq);
+  for (i=0; i<COUNT(echoes); i++) {
+    uint32_t expected = echoesExpected[i].echoTime*1000;
+    bool ok = ping_pingNs(&pingData, MAX_PERIOD, &ns) && ns == expected;
+    if (!ok) {
+      failures++;
+    }
+    printf("  ping %u: %9u ns, expected %9u ns %s\n", i, ns, expected, ok ? "ok" : "FAILED");
+    sim_run(10000);
+  }
+  return 0 == failures;
+}
+
+int
+main(int argc, char **argv) {
+  uint8_t failed = 0;
+  uint8_t i = 0;
+
+  sim_setVerbose(argc > 1);
+  for (i=0; i<COUNT(scenarios); i++) {
+    if (!runScenario(&scenarios[i])) {
+      failed++;
+    }
+  }
+  if (!runSharedInterrupts()) {
+    failed++;
+  }
+  if (!runBusy()) {
+    failed++;
+  }
+  if (!runEventOverflow()) {
+    failed++;
+  }
+  if (!runFilter()) {
+    failed++;
+  }
+  if (!runTracker()) {
+    failed++;
+  }
+  if (!runAdaptive()) {
+    failed++;
+  }
+  if (!runBurst()) {
+    failed++;
+  }
+  if (!runSchedulerLearn()) {
+    failed++;
+  }
+  if (!runAmbient()) {
+    failed++;
+  }
+  if (!runFixedPoint()) {
+    failed++;
+  }
+  // 80 and 160 MHz have shortcuts in the conversion, any other clock takes the division
+  for (i=0; i<COUNT(cpuFreqs); i++) {
+    if (!runNanoseconds(cpuFreqs[i])) {
+      failed++;
+    }
+  }
+  printf("%u of %u scenarios failed\n", failed, (unsigned)(COUNT(scenarios) + 10 + COUNT(cpuFreqs)));
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+/*
+* c_types.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Simulated ESP8266 NONOS SDK header for the host build, only what the drivers use.
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+typedef uint8_t uint8; typedef int8_t sint8; typedef uint16_t uint16; typedef int16_t sint16;
+typedef uint32_t uint32; typedef int32_t sint32; typedef int32_t int32; typedef uint64_t uint64; typedef int64_t sint64;
+#define BIT(nr) (1UL << (nr))
+#define BIT0 1
+#define BIT1 2
+#define BIT2 4
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define ICACHE_RAM_ATTR
+#define STORE_ATTR __attribute__((aligned(4)))
+#define LOCAL static
+// every register access goes to the simulator, see host/sim.c
+uint32_t sim_readReg(uint32_t addr);
+void sim_writeReg(uint32_t addr, uint32_t value);
+#define READ_PERI_REG(addr) sim_readReg((uint32_t)(addr))
+#define WRITE_PERI_REG(addr, val) sim_writeReg((uint32_t)(addr), (uint32_t)(val))
+#define CLEAR_PERI_REG_MASK(reg, mask) WRITE_PERI_REG((reg), (READ_PERI_REG(reg)&(~(mask))))
+#define SET_PERI_REG_MASK(reg, mask)   WRITE_PERI_REG((reg), (READ_PERI_REG(reg)|(mask)))
+#endif
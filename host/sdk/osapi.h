@@ -0,0 +1,57 @@
+/*
+* osapi.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Simulated ESP8266 NONOS SDK header for the host build, only what the drivers use.
+#ifndef _OSAPI_H_
+#define _OSAPI_H_
+#include <string.h>
+#include "os_type.h"
+#include "user_config.h"
+#include "user_interface.h"
+void ets_delay_us(uint32_t us);
+int ets_printf(const char *fmt, ...) __attribute__((format(printf,1,2)));
+void ets_timer_arm_new(ETSTimer *ptimer, uint32_t time, bool repeat_flag, bool ms_flag);
+void ets_timer_disarm(ETSTimer *ptimer);
+void ets_timer_setfn(ETSTimer *ptimer, ETSTimerFunc *pfunction, void *parg);
+void ets_install_putc1(void *routine);
+int ets_sprintf(char *str, const char *format, ...) __attribute__((format(printf,2,3)));
+#define os_delay_us ets_delay_us
+#define os_printf ets_printf
+#define os_sprintf ets_sprintf
+#define os_timer_arm(a, b, c) ets_timer_arm_new(a, b, c, 1)
+#define os_timer_arm_us(a, b, c) ets_timer_arm_new(a, b, c, 0)
+#define os_timer_disarm ets_timer_disarm
+#define os_timer_setfn ets_timer_setfn
+#define os_install_putc1 ets_install_putc1
+#define os_memset memset
+#define os_memcpy memcpy
+#define os_strlen strlen
+#endif
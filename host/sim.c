@@ -0,0 +1,925 @@
+/*
+* sim.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "sim.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "user_interface.h"
+
+#define SIM_MAX_TIMERS 32
+#define SIM_MAX_EDGES 4
+#define SIM_MAX_GENERIC_REGS 64
+#define SIM_TASK_PRIOS 3
+#define SIM_MAX_INTERRUPTS 32
+#define SIM_RUNAWAY_LIMIT 100000 // an interrupt handler that doesn't clear its interrupt
+#define SIM_GPIO_PINS 16
+#define SIM_GPIO_PIN_MASK 0xffff
+#define SIM_FRC1_TICKS_PER_US 5 // the drivers run FRC1 divided by 16
+#define SIM_NEVER 0xffffffffffffffffULL
+
+typedef struct {
+  uint8_t triggerPin;
+  uint8_t echoPin;
+  const Sim_Response *responses;
+  uint16_t count;
+  uint16_t next;
+  bool repeat;
+  bool triggerLevel;
+  uint64_t triggerRoseAt;
+  bool isStuck;
+  uint32_t wakeLength; // us, the shortest trigger pulse that wakes up a stuck sensor
+  bool reverberates;   // see sim_setReverberation()
+  uint64_t bounceAt;   // when the second bounce of the last echo comes back
+  uint32_t crosstalk[SIM_MAX_SENSORS]; // us from the burst of each other sensor to this one, 0 if it can't hear it, see sim_setCrosstalk()
+  bool hasEmitted;
+  uint64_t emittedAt;  // when the last burst went out
+  uint64_t echoEndsAt; // when the last SIM_ECHO echo ends
+  uint8_t edges;   // scheduled echo pin changes, in time order
+  uint64_t edgeAt[SIM_MAX_EDGES];
+  bool edgeLevel[SIM_MAX_EDGES];
+} Sim_Sensor;
+
+typedef struct {
+  os_task_t task;
+  os_event_t *queue;
+  uint8_t length;
+  uint8_t head;
+  uint8_t count;
+} Sim_Task;
+
+typedef struct {
+  ETSTimer *timer;
+  uint64_t at;
+} Sim_Timer;
+
+static uint64_t simTime = 0;
+static uint32_t simTimeOffset = 0;
+static uint32_t simCycleOffset = 0;
+static uint8_t simCpuFreq = SIM_CPU_FREQ;
+static bool simVerbose = false;
+static Sim_Stats simStats;
+
+// GPIO
+static uint32_t simGpioOut = 0;
+static uint32_t simGpioEnable = 0;
+static uint32_t simGpioExternal = 0; // the levels driven by the sensors
+static uint32_t simGpioLastIn = 0;
+static uint32_t simGpioStatus = 0;
+static uint64_t simGpioRaisedAt = 0;
+static uint32_t simGpioPinConf[SIM_GPIO_PINS];
+
+// FRC1
+static uint32_t simFrc1Ctrl = 0;
+static uint32_t simFrc1Load = 0;
+static bool simFrc1Armed = false;
+static bool simFrc1Pending = false;
+static uint64_t simFrc1At = 0;
+
+// other registers, just stored
+static uint32_t simGenericAddr[SIM_MAX_GENERIC_REGS];
+static uint32_t simGenericValue[SIM_MAX_GENERIC_REGS];
+static uint8_t simGenerics = 0;
+
+// interrupts
+static int_handler_t simHandlers[SIM_MAX_INTERRUPTS];
+static void *simHandlerArgs[SIM_MAX_INTERRUPTS];
+static uint32_t simIntMask = 0;
+static bool simIntLocked = false;
+static bool simDispatching = false;
+static bool simDelaying = false;
+static uint32_t simIsrCost = 0;
+static Sim_IsrCost *simIsr = NULL; // what the running interrupt handler did, NULL outside of the handlers
+static uint32_t simBlackoutPeriod = 0;
+static uint32_t simBlackoutLength = 0;
+
+static Sim_Task simTasks[SIM_TASK_PRIOS];
+static Sim_Timer simTimers[SIM_MAX_TIMERS];
+static uint8_t simTimerCount = 0;
+static Sim_Sensor simSensors[SIM_MAX_SENSORS];
+static uint8_t simSensorCount = 0;
+
+static void simDispatch(void);
+
+/**
+ * Counts register accesses and SDK calls, also against the running interrupt handler.
+ */
+static void
+simCountRegisters(uint32_t reads, uint32_t writes) {
+  simStats.registerReads += reads;
+  simStats.registerWrites += writes;
+  if (simIsr) {
+    simIsr->registerReads += reads;
+    simIsr->registerWrites += writes;
+  }
+}
+
+static void
+simCountSdkCall(void) {
+  if (simIsr) {
+    simIsr->sdkCalls++;
+  }
+}
+
+/**
+ * Schedules a level change of a sensor's echo pin 'delay' us from now.
+ */
+static void
+simSensorSchedule(Sim_Sensor *sensor, uint32_t delay, bool level) {
+  if (sensor->edges >= SIM_MAX_EDGES) {
+    fprintf(stderr, "sim: too many echo edges scheduled\n");
+    abort();
+  }
+  sensor->edgeAt[sensor->edges] = simTime + delay;
+  sensor->edgeLevel[sensor->edges] = level;
+  sensor->edges++;
+}
+
+/**
+ * Returns when the burst of 'sensor' that went out at 'emittedAt' is heard by 'listener',
+ * or 0 if it can't hear it.
+ */
+static uint64_t
+simCrosstalkAt(Sim_Sensor *listener, Sim_Sensor *sensor, uint64_t emittedAt) {
+  uint32_t travelTime = listener->crosstalk[sensor - simSensors];
+  return travelTime ? emittedAt + travelTime : 0;
+}
+
+/**
+ * 'sensor' sends a burst at 'emittedAt'. The sensors that hear it, and are waiting for an echo
+ * that comes back later than that, take it for their echo.
+ */
+static void
+simSensorEmits(Sim_Sensor *sensor, uint64_t emittedAt) {
+  uint8_t i = 0;
+
+  sensor->hasEmitted = true;
+  sensor->emittedAt = emittedAt;
+  for (i=0; i<simSensorCount; i++) {
+    Sim_Sensor *listener = &simSensors[i];
+    uint64_t heardAt = simCrosstalkAt(listener, sensor, emittedAt);
+    if (heardAt && listener->edges && heardAt > listener->emittedAt && heardAt < listener->echoEndsAt &&
+        !listener->edgeLevel[listener->edges-1] && listener->edgeAt[listener->edges-1] == listener->echoEndsAt) {
+      listener->edgeAt[listener->edges-1] = heardAt;
+      listener->echoEndsAt = heardAt;
+    }
+  }
+}
+
+/**
+ * The end of a trigger pulse, the sensor answers with its next response.
+ */
+static void
+simSensorTriggered(Sim_Sensor *sensor) {
+  const Sim_Response *response = NULL;
+  uint64_t emittedAt = 0;
+  uint32_t heard = 0;
+  uint8_t i = 0;
+
+  if (simTime - sensor->triggerRoseAt < 10) {
+    // too short to be a trigger pulse
+    return;
+  }
+  if (sensor->isStuck) {
+    if (simTime - sensor->triggerRoseAt < sensor->wakeLength) {
+      // too short to wake it up
+      return;
+    }
+    sensor->isStuck = false;
+    sensor->edges = 0;
+    simSensorSchedule(sensor, 0, false);
+    return;
+  }
+  if (sensor->edges) {
+    // busy with the previous echo
+    return;
+  }
+  simStats.triggers++;
+  if (sensor->next >= sensor->count) {
+    if (!sensor->repeat || !sensor->count) {
+      return;
+    }
+    sensor->next = 0;
+  }
+  response = &sensor->responses[sensor->next++];
+  switch (response->type) {
+    case SIM_ECHO:
+      emittedAt = simTime + SIM_ECHO_DELAY;
+      heard = response->echoTime;
+      if (sensor->reverberates && sensor->bounceAt > emittedAt && sensor->bounceAt - emittedAt < heard) {
+        // the second bounce of the previous echo beats this one
+        heard = sensor->bounceAt - emittedAt;
+      }
+      for (i=0; i<simSensorCount; i++) {
+        // the burst of another sensor, sent before this one, beats the echo
+        uint64_t heardAt = simSensors[i].hasEmitted ? simCrosstalkAt(sensor, &simSensors[i], simSensors[i].emittedAt) : 0;
+        if (heardAt > emittedAt && heardAt - emittedAt < heard) {
+          heard = heardAt - emittedAt;
+        }
+      }
+      sensor->bounceAt = emittedAt + 2*response->echoTime;
+      sensor->echoEndsAt = emittedAt + heard;
+      simSensorSchedule(sensor, SIM_ECHO_DELAY, true);
+      simSensorSchedule(sensor, SIM_ECHO_DELAY + heard, false);
+      simSensorEmits(sensor, emittedAt);
+      break;
+    case SIM_NO_ECHO:
+      simSensorSchedule(sensor, SIM_ECHO_DELAY, true);
+      simSensorSchedule(sensor, SIM_ECHO_DELAY + SIM_NO_ECHO_LENGTH, false);
+      simSensorEmits(sensor, simTime + SIM_ECHO_DELAY);
+      break;
+    case SIM_STUCK_HIGH:
+      simSensorSchedule(sensor, SIM_ECHO_DELAY, true);
+      sensor->isStuck = true;
+      sensor->wakeLength = response->echoTime;
+      break;
+    case SIM_GHOST:
+      simSensorSchedule(sensor, SIM_ECHO_DELAY, true);
+      simSensorSchedule(sensor, SIM_ECHO_DELAY + response->ghostTime, false);
+      simSensorSchedule(sensor, SIM_ECHO_DELAY + 2*response->ghostTime, true);
+      simSensorSchedule(sensor, SIM_ECHO_DELAY + 2*response->ghostTime + response->echoTime, false);
+      simSensorEmits(sensor, simTime + SIM_ECHO_DELAY);
+      break;
+    default:
+      break;
+  }
+}
+
+static uint32_t
+simGpioInput(void) {
+  return ((simGpioEnable & simGpioOut) | (~simGpioEnable & simGpioExternal)) & SIM_GPIO_PIN_MASK;
+}
+
+/**
+ * Recomputes the GPIO input levels, raises the GPIO interrupts and lets the sensors see their trigger pins.
+ */
+static void
+simGpioUpdate(void) {
+  uint32_t in = simGpioInput();
+  uint32_t changed = in ^ simGpioLastIn;
+  uint32_t raised = 0;
+  uint8_t pin = 0;
+  uint8_t i = 0;
+
+  for (pin=0; pin<SIM_GPIO_PINS; pin++) {
+    switch (GPIO_PIN_INT_TYPE_GET(simGpioPinConf[pin])) {
+      case GPIO_PIN_INTR_POSEDGE:
+        raised |= changed & in & BIT(pin);
+        break;
+      case GPIO_PIN_INTR_NEGEDGE:
+        raised |= changed & ~in & BIT(pin);
+        break;
+      case GPIO_PIN_INTR_ANYEDGE:
+        raised |= changed & BIT(pin);
+        break;
+      case GPIO_PIN_INTR_LOLEVEL:
+        raised |= ~in & BIT(pin);
+        break;
+      case GPIO_PIN_INTR_HILEVEL:
+        raised |= in & BIT(pin);
+        break;
+      default:
+        break;
+    }
+  }
+  if (raised & ~simGpioStatus) {
+    if (!simGpioStatus) {
+      simGpioRaisedAt = simTime;
+    }
+    simGpioStatus |= raised;
+  }
+  simGpioLastIn = in;
+
+  for (i=0; i<simSensorCount; i++) {
+    Sim_Sensor *sensor = &simSensors[i];
+    bool level = (simGpioEnable & simGpioOut & BIT(sensor->triggerPin)) != 0;
+    if (level != sensor->triggerLevel) {
+      sensor->triggerLevel = level;
+      if (level) {
+        sensor->triggerRoseAt = simTime;
+      } else {
+        simSensorTriggered(sensor);
+      }
+    }
+  }
+}
+
+static uint64_t
+simNextEvent(void) {
+  uint64_t next = simFrc1Armed ? simFrc1At : SIM_NEVER;
+  uint8_t i = 0;
+  for (i=0; i<simSensorCount; i++) {
+    if (simSensors[i].edges && simSensors[i].edgeAt[0] < next) {
+      next = simSensors[i].edgeAt[0];
+    }
+  }
+  return next;
+}
+
+/**
+ * Moves the clock to 'to', applying the hardware events on the way. Doesn't call any handlers.
+ */
+static void
+simStep(uint64_t to) {
+  uint64_t next = 0;
+  uint8_t i = 0;
+  uint8_t e = 0;
+
+  while ((next = simNextEvent()) <= to) {
+    if (next > simTime) {
+      simTime = next;
+    }
+    if (simFrc1Armed && simFrc1At <= simTime) {
+      simFrc1Armed = false;
+      simFrc1Pending = true;
+    }
+    for (i=0; i<simSensorCount; i++) {
+      Sim_Sensor *sensor = &simSensors[i];
+      while (sensor->edges && sensor->edgeAt[0] <= simTime) {
+        if (sensor->edgeLevel[0]) {
+          simGpioExternal |= BIT(sensor->echoPin);
+        } else {
+          simGpioExternal &= ~BIT(sensor->echoPin);
+        }
+        sensor->edges--;
+        for (e=0; e<sensor->edges; e++) {
+          sensor->edgeAt[e] = sensor->edgeAt[e+1];
+          sensor->edgeLevel[e] = sensor->edgeLevel[e+1];
+        }
+      }
+    }
+    simGpioUpdate();
+  }
+  if (to > simTime) {
+    simTime = to;
+  }
+}
+
+static bool
+simInBlackout(void) {
+  return simBlackoutPeriod && (simTime % simBlackoutPeriod) < simBlackoutLength;
+}
+
+static bool
+simIsEnabled(uint8_t inum) {
+  return simHandlers[inum] && !(simIntMask & BIT(inum)) && !simIntLocked && !simInBlackout();
+}
+
+static void
+simCallHandler(uint8_t inum, uint64_t raisedAt) {
+  uint32_t latency = (uint32_t)(simTime - raisedAt);
+  simStats.latencySum += latency;
+  simStats.latencyCount++;
+  if (latency > simStats.latencyMax) {
+    simStats.latencyMax = latency;
+  }
+  simIsr = ETS_GPIO_INUM == inum ? &simStats.gpioIsr : &simStats.timerIsr;
+  simHandlers[inum](simHandlerArgs[inum]);
+  simIsr = NULL;
+  if (simIsrCost) {
+    simStats.isrTime += simIsrCost;
+    if (!simDelaying) {
+      simStats.busyTime += simIsrCost;
+    }
+    simStep(simTime + simIsrCost);
+  }
+}
+
+/**
+ * Calls the interrupt handlers of every pending interrupt that isn't masked.
+ */
+static void
+simDispatch(void) {
+  uint32_t runaway = 0;
+  if (simDispatching) {
+    // an interrupt handler can't be interrupted
+    return;
+  }
+  simDispatching = true;
+  while (true) {
+    if (simFrc1Pending && simIsEnabled(ETS_FRC_TIMER1_INUM)) {
+      simStats.timerInterrupts++;
+      simCallHandler(ETS_FRC_TIMER1_INUM, simFrc1At);
+    } else if (simGpioStatus && simIsEnabled(ETS_GPIO_INUM)) {
+      simStats.gpioInterrupts++;
+      simCallHandler(ETS_GPIO_INUM, simGpioRaisedAt);
+    } else {
+      break;
+    }
+    if (++runaway > SIM_RUNAWAY_LIMIT) {
+      fprintf(stderr, "sim: an interrupt handler doesn't clear its interrupt\n");
+      abort();
+    }
+  }
+  simDispatching = false;
+}
+
+/**
+ * Runs one task event, returns false if there was nothing to run.
+ */
+static bool
+simRunTask(void) {
+  int8_t prio = 0;
+  for (prio=SIM_TASK_PRIOS-1; prio>=0; prio--) {
+    Sim_Task *task = &simTasks[prio];
+    if (task->count) {
+      os_event_t event = task->queue[task->head];
+      task->head = (task->head + 1) % task->length;
+      task->count--;
+      simStats.tasks++;
+      task->task(&event);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Runs one os_timer that is due, returns false if there was nothing to run.
+ */
+static bool
+simRunTimer(void) {
+  uint8_t i = 0;
+  for (i=0; i<simTimerCount; i++) {
+    if (simTimers[i].at <= simTime) {
+      ETSTimer *timer = simTimers[i].timer;
+      if (timer->timer_period) {
+        simTimers[i].at += timer->timer_period;
+      } else {
+        simTimers[i] = simTimers[--simTimerCount];
+      }
+      simStats.timers++;
+      timer->timer_func(timer->timer_arg);
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t
+simNextTimer(void) {
+  uint64_t next = SIM_NEVER;
+  uint8_t i = 0;
+  for (i=0; i<simTimerCount; i++) {
+    if (simTimers[i].at < next) {
+      next = simTimers[i].at;
+    }
+  }
+  return next;
+}
+
+/**
+ * Advances the clock to 'to'. The code under test only runs as interrupt handlers,
+ * or also as tasks and timers when 'runTasks' is set.
+ */
+static void
+simAdvance(uint64_t to, bool runTasks) {
+  uint64_t next = 0;
+  while (true) {
+    simDispatch();
+    if (runTasks && (simRunTask() || simRunTimer())) {
+      continue;
+    }
+    next = simNextEvent();
+    if (runTasks && simNextTimer() < next) {
+      next = simNextTimer();
+    }
+    if (simInBlackout() && (simFrc1Pending || simGpioStatus)) {
+      uint64_t end = simTime - simTime % simBlackoutPeriod + simBlackoutLength;
+      if (end < next) {
+        next = end;
+      }
+    }
+    if (next > to) {
+      break;
+    }
+    simStep(next);
+  }
+  simStep(to);
+  simDispatch();
+}
+
+// the simulated SDK
+
+uint32_t
+sim_readReg(uint32_t addr) {
+  uint8_t i = 0;
+  simCountRegisters(1, 0);
+  if (addr >= PERIPHS_GPIO_BASEADDR && addr < PERIPHS_GPIO_BASEADDR + GPIO_PIN_ADDR(SIM_GPIO_PINS)) {
+    uint32_t reg = addr - PERIPHS_GPIO_BASEADDR;
+    switch (reg) {
+      case GPIO_OUT_ADDRESS:
+        return simGpioOut;
+      case GPIO_ENABLE_ADDRESS:
+        return simGpioEnable;
+      case GPIO_IN_ADDRESS:
+        return simGpioInput();
+      case GPIO_STATUS_ADDRESS:
+        return simGpioStatus;
+      default:
+        if (reg >= GPIO_PIN0_ADDRESS) {
+          return simGpioPinConf[(reg - GPIO_PIN0_ADDRESS) >> 2];
+        }
+        return 0;
+    }
+  }
+  if (addr >= PERIPHS_TIMER_BASEDDR && addr <= PERIPHS_TIMER_BASEDDR + FRC1_INT_ADDRESS) {
+    switch (addr - PERIPHS_TIMER_BASEDDR) {
+      case FRC1_LOAD_ADDRESS:
+        return simFrc1Load;
+      case FRC1_COUNT_ADDRESS:
+        return simFrc1Armed ? (uint32_t)(simFrc1At - simTime) * SIM_FRC1_TICKS_PER_US : 0;
+      case FRC1_CTRL_ADDRESS:
+        return simFrc1Ctrl;
+      default:
+        return simFrc1Pending;
+    }
+  }
+  for (i=0; i<simGenerics; i++) {
+    if (simGenericAddr[i] == addr) {
+      return simGenericValue[i];
+    }
+  }
+  return 0;
+}
+
+void
+sim_writeReg(uint32_t addr, uint32_t value) {
+  uint8_t i = 0;
+  simCountRegisters(0, 1);
+  if (addr >= PERIPHS_GPIO_BASEADDR && addr < PERIPHS_GPIO_BASEADDR + GPIO_PIN_ADDR(SIM_GPIO_PINS)) {
+    uint32_t reg = addr - PERIPHS_GPIO_BASEADDR;
+    switch (reg) {
+      case GPIO_OUT_ADDRESS:
+        simGpioOut = value;
+        break;
+      case GPIO_OUT_W1TS_ADDRESS:
+        simGpioOut |= value;
+        break;
+      case GPIO_OUT_W1TC_ADDRESS:
+        simGpioOut &= ~value;
+        break;
+      case GPIO_ENABLE_ADDRESS:
+        simGpioEnable = value;
+        break;
+      case GPIO_ENABLE_W1TS_ADDRESS:
+        simGpioEnable |= value;
+        break;
+      case GPIO_ENABLE_W1TC_ADDRESS:
+        simGpioEnable &= ~value;
+        break;
+      case GPIO_STATUS_ADDRESS:
+        simGpioStatus = value;
+        break;
+      case GPIO_STATUS_W1TS_ADDRESS:
+        if (!simGpioStatus) {
+          simGpioRaisedAt = simTime;
+        }
+        simGpioStatus |= value;
+        break;
+      case GPIO_STATUS_W1TC_ADDRESS:
+        simGpioStatus &= ~value;
+        break;
+      default:
+        if (reg >= GPIO_PIN0_ADDRESS) {
+          simGpioPinConf[(reg - GPIO_PIN0_ADDRESS) >> 2] = value;
+        }
+        break;
+    }
+    simGpioUpdate();
+    simDispatch();
+    return;
+  }
+  if (addr >= PERIPHS_TIMER_BASEDDR && addr <= PERIPHS_TIMER_BASEDDR + FRC1_INT_ADDRESS) {
+    switch (addr - PERIPHS_TIMER_BASEDDR) {
+      case FRC1_LOAD_ADDRESS:
+        simFrc1Load = value;
+        simFrc1Armed = (simFrc1Ctrl & FRC1_ENABLE_TIMER) != 0;
+        simFrc1At = simTime + (value + SIM_FRC1_TICKS_PER_US - 1) / SIM_FRC1_TICKS_PER_US;
+        break;
+      case FRC1_CTRL_ADDRESS:
+        simFrc1Ctrl = value;
+        break;
+      case FRC1_INT_ADDRESS:
+        simFrc1Pending = false;
+        break;
+      default:
+        break;
+    }
+    return;
+  }
+  for (i=0; i<simGenerics; i++) {
+    if (simGenericAddr[i] == addr) {
+      simGenericValue[i] = value;
+      return;
+    }
+  }
+  if (simGenerics < SIM_MAX_GENERIC_REGS) {
+    simGenericAddr[simGenerics] = addr;
+    simGenericValue[simGenerics++] = value;
+  }
+}
+
+uint32_t
+sim_getCycleCount(void) {
+  return (uint32_t)(simTime * simCpuFreq) + simCycleOffset;
+}
+
+void
+gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask) {
+  simCountSdkCall();
+  simCountRegisters(0, 4); // out set, out clear, enable set, enable clear
+  simGpioOut = (simGpioOut | set_mask) & ~clear_mask;
+  simGpioEnable = (simGpioEnable | enable_mask) & ~disable_mask;
+  simGpioUpdate();
+  simDispatch();
+}
+
+uint32
+gpio_input_get(void) {
+  simCountSdkCall();
+  simCountRegisters(1, 0);
+  return simGpioInput();
+}
+
+void
+gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state) {
+  simCountSdkCall();
+  simCountRegisters(1, 1); // read-modify-write of GPIO_PINn
+  simGpioPinConf[i] = (simGpioPinConf[i] & ~GPIO_PIN_INT_TYPE_MASK) | GPIO_PIN_INT_TYPE_SET(intr_state);
+  simGpioUpdate();
+  simDispatch();
+}
+
+void
+gpio_register_set(uint32 reg_id, uint32 value) {
+  simCountSdkCall();
+  simCountRegisters(0, 1);
+  simGpioPinConf[(reg_id - GPIO_PIN0_ADDRESS) >> 2] = value;
+}
+
+void
+gpio_init(void) {
+}
+
+void
+ets_isr_attach(int i, int_handler_t handler, void *arg) {
+  simHandlers[i] = handler;
+  simHandlerArgs[i] = arg;
+}
+
+void
+ets_isr_mask(unsigned intr) {
+  simIntMask |= intr;
+}
+
+void
+ets_isr_unmask(unsigned intr) {
+  simIntMask &= ~intr;
+  simDispatch();
+}
+
+void
+ets_intr_lock(void) {
+  simIntLocked = true;
+}
+
+void
+ets_intr_unlock(void) {
+  simIntLocked = false;
+  simDispatch();
+}
+
+void
+ets_delay_us(uint32_t us) {
+  bool wasDelaying = simDelaying;
+  simStats.delayTime += us;
+  simStats.busyTime += us;
+  simDelaying = true;
+  simAdvance(simTime + us, false);
+  simDelaying = wasDelaying;
+}
+
+int
+ets_printf(const char *fmt, ...) {
+  va_list args;
+  int length = 0;
+  if (simVerbose) {
+    va_start(args, fmt);
+    length = vprintf(fmt, args);
+    va_end(args);
+  }
+  return length;
+}
+
+void
+ets_timer_setfn(ETSTimer *ptimer, ETSTimerFunc *pfunction, void *parg) {
+  ptimer->timer_func = pfunction;
+  ptimer->timer_arg = parg;
+}
+
+void
+ets_timer_disarm(ETSTimer *ptimer) {
+  uint8_t i = 0;
+  for (i=0; i<simTimerCount; i++) {
+    if (simTimers[i].timer == ptimer) {
+      simTimers[i] = simTimers[--simTimerCount];
+      return;
+    }
+  }
+}
+
+void
+ets_timer_arm_new(ETSTimer *ptimer, uint32_t time, bool repeat_flag, bool ms_flag) {
+  uint32_t us = ms_flag ? time * 1000 : time;
+  ets_timer_disarm(ptimer);
+  if (simTimerCount >= SIM_MAX_TIMERS) {
+    fprintf(stderr, "sim: too many os_timers\n");
+    abort();
+  }
+  ptimer->timer_period = repeat_flag ? us : 0;
+  simTimers[simTimerCount].timer = ptimer;
+  simTimers[simTimerCount++].at = simTime + us;
+}
+
+void
+ets_install_putc1(void *routine) {
+}
+
+uint32
+system_get_time(void) {
+  simCountSdkCall();
+  return (uint32_t)simTime + simTimeOffset;
+}
+
+uint8
+system_get_cpu_freq(void) {
+  simCountSdkCall();
+  return simCpuFreq;
+}
+
+bool
+system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen) {
+  if (prio >= SIM_TASK_PRIOS) {
+    return false;
+  }
+  simTasks[prio].task = task;
+  simTasks[prio].queue = queue;
+  simTasks[prio].length = qlen;
+  simTasks[prio].head = 0;
+  simTasks[prio].count = 0;
+  return true;
+}
+
+bool
+system_os_post(uint8 prio, os_signal_t sig, os_param_t par) {
+  Sim_Task *task = prio < SIM_TASK_PRIOS ? &simTasks[prio] : NULL;
+  simCountSdkCall();
+  if (!task || !task->task || task->count >= task->length) {
+    return false;
+  }
+  task->queue[(task->head + task->count) % task->length].sig = sig;
+  task->queue[(task->head + task->count) % task->length].par = par;
+  task->count++;
+  return true;
+}
+
+// the simulator API
+
+void
+sim_init(uint32_t startTime, uint32_t startCycles) {
+  simTime = 0;
+  simTimeOffset = startTime;
+  simCycleOffset = startCycles;
+  simCpuFreq = SIM_CPU_FREQ;
+  simGpioExternal = 0;
+  simGpioStatus = 0;
+  simFrc1Armed = false;
+  simFrc1Pending = false;
+  simIntLocked = false;
+  simIsrCost = 0;
+  simBlackoutPeriod = 0;
+  simBlackoutLength = 0;
+  simTimerCount = 0;
+  simSensorCount = 0;
+  memset(&simStats, 0, sizeof(simStats));
+  simGpioUpdate();
+}
+
+void
+sim_setCpuFreq(uint8_t mhz) {
+  // CCOUNT carries on from where it is, only its rate changes
+  uint32_t cycles = sim_getCycleCount();
+  simCpuFreq = mhz;
+  simCycleOffset = cycles - (uint32_t)(simTime * simCpuFreq);
+}
+
+int8_t
+sim_addSensor(uint8_t triggerPin, uint8_t echoPin, const Sim_Response *responses, uint16_t count, bool repeat) {
+  Sim_Sensor *sensor = NULL;
+  if (simSensorCount >= SIM_MAX_SENSORS) {
+    return -1;
+  }
+  sensor = &simSensors[simSensorCount];
+  memset(sensor, 0, sizeof(Sim_Sensor));
+  sensor->triggerPin = triggerPin;
+  sensor->echoPin = echoPin;
+  sim_setResponses(simSensorCount, responses, count, repeat);
+  return simSensorCount++;
+}
+
+void
+sim_setCrosstalk(int8_t a, int8_t b, uint32_t travelTime) {
+  simSensors[a].crosstalk[b] = travelTime;
+  simSensors[b].crosstalk[a] = travelTime;
+}
+
+void
+sim_setReverberation(int8_t sensor, bool enable) {
+  simSensors[sensor].reverberates = enable;
+  simSensors[sensor].bounceAt = 0;
+}
+
+void
+sim_setResponses(int8_t sensor, const Sim_Response *responses, uint16_t count, bool repeat) {
+  simSensors[sensor].responses = responses;
+  simSensors[sensor].count = count;
+  simSensors[sensor].next = 0;
+  simSensors[sensor].repeat = repeat;
+}
+
+void
+sim_setIsrCost(uint32_t cost) {
+  simIsrCost = cost;
+}
+
+void
+sim_setInterruptBlackout(uint32_t period, uint32_t length) {
+  simBlackoutPeriod = period;
+  simBlackoutLength = length;
+}
+
+void
+sim_run(uint32_t us) {
+  simAdvance(simTime + us, true);
+}
+
+bool
+sim_runUntil(bool (*done)(void *arg), void *arg, uint32_t timeout) {
+  uint64_t end = simTime + timeout;
+  while (!done(arg)) {
+    if (simTime >= end) {
+      return false;
+    }
+    // small steps, so that 'done' is checked often
+    simAdvance(simTime + 10 < end ? simTime + 10 : end, true);
+  }
+  return true;
+}
+
+uint64_t
+sim_now(void) {
+  return simTime;
+}
+
+void
+sim_getStats(Sim_Stats *stats, bool reset) {
+  *stats = simStats;
+  if (reset) {
+    memset(&simStats, 0, sizeof(simStats));
+  }
+}
+
+void
+sim_setVerbose(bool verbose) {
+  simVerbose = verbose;
+}
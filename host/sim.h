@@ -0,0 +1,164 @@
+/*
+* sim.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+#include "c_types.h"
+
+/**
+ * A simulated ESP8266 for running the drivers on a workstation: GPIO and FRC1 registers,
+ * interrupt delivery, tasks, os_timers and a virtual clock. Nothing happens in real time,
+ * every run of the same script gives the same result.
+ *
+ * Time only moves when the simulator is told to run (sim_run()), or when the code under test
+ * busy waits with os_delay_us(). Interrupts are delivered as soon as they are raised and not
+ * masked, tasks and os_timers only run from sim_run().
+ */
+
+#define SIM_CPU_FREQ 80 // MHz, the default, see sim_setCpuFreq()
+#define SIM_MAX_SENSORS 16
+#define SIM_ECHO_DELAY 450 // us from the end of the trigger pulse to the start of the echo
+#define SIM_NO_ECHO_LENGTH 38000 // us, how long an HC-SR04 holds the echo pin high when nothing comes back
+
+typedef enum {
+  SIM_ECHO = 0,    // a normal echo of 'echoTime' us
+  SIM_NO_ECHO,     // nothing came back, the echo pin is high for SIM_NO_ECHO_LENGTH us
+  SIM_SILENT,      // the sensor doesn't answer at all
+  SIM_STUCK_HIGH,  // the echo pin goes high and stays high until a trigger pulse of at least 'echoTime' us
+  SIM_GHOST        // a 'ghostTime' us pulse, then the echo after 'ghostTime' us more
+} Sim_ResponseType;
+
+typedef struct {
+  Sim_ResponseType type;
+  uint32_t echoTime;
+  uint32_t ghostTime;
+} Sim_Response;
+
+/**
+ * What the interrupt handlers did while they ran, the real cost of a handler is roughly
+ * proportional to its register accesses, plus a function call into the SDK for each SDK call.
+ */
+typedef struct {
+  uint32_t registerReads;
+  uint32_t registerWrites;
+  uint32_t sdkCalls;        // system_get_time(), gpio_pin_intr_state_set(), gpio_output_set() etc.
+} Sim_IsrCost;
+
+typedef struct {
+  uint32_t gpioInterrupts;  // calls to the GPIO interrupt handler
+  uint32_t timerInterrupts; // calls to the FRC1 interrupt handler
+  uint32_t tasks;           // tasks run
+  uint32_t timers;          // os_timer callbacks run
+  uint32_t triggers;        // trigger pulses seen by the sensors
+  uint32_t registerReads;   // peripheral register accesses, the SDK GPIO functions count as the
+  uint32_t registerWrites;  // register accesses they do
+  uint32_t delayTime;       // us spent in os_delay_us()
+  uint64_t isrTime;         // us charged to the interrupt handlers
+  uint64_t busyTime;        // us the CPU was busy: in os_delay_us(), or in a handler outside of it
+  uint32_t latencyMax;      // us, longest time an interrupt waited for delivery
+  uint64_t latencySum;
+  uint32_t latencyCount;
+  Sim_IsrCost gpioIsr;      // done by the GPIO interrupt handler
+  Sim_IsrCost timerIsr;     // done by the FRC1 interrupt handler
+} Sim_Stats;
+
+/**
+ * Resets the clock, the sensors and the statistics. system_get_time() starts at 'startTime' and
+ * CCOUNT at 'startCycles', start close to 0xffffffff to test clock wraps. The registers, interrupt
+ * handlers, tasks and queued task events of the drivers are kept, the drivers only set them up once.
+ */
+void sim_init(uint32_t startTime, uint32_t startCycles);
+
+/**
+ * Sets the CPU clock in MHz, the rate of CCOUNT and what system_get_cpu_freq() returns.
+ * CCOUNT carries on from its current value. sim_init() goes back to SIM_CPU_FREQ.
+ */
+void sim_setCpuFreq(uint8_t mhz);
+
+/**
+ * Connects a simulated sensor to a trigger and an echo pin (the same pin for single pin mode).
+ * The sensor answers the trigger pulses with 'responses' in order, starting over when 'repeat' is set.
+ */
+int8_t sim_addSensor(uint8_t triggerPin, uint8_t echoPin, const Sim_Response *responses, uint16_t count, bool repeat);
+
+/**
+ * Replaces the responses of a sensor.
+ */
+void sim_setResponses(int8_t sensor, const Sim_Response *responses, uint16_t count, bool repeat);
+
+/**
+ * Makes the second bounce of every SIM_ECHO echo (twice the echo time after the burst went out)
+ * audible to the sensor. A ping whose burst goes out before that hears the bounce as its echo,
+ * if it comes back before its own. Off by default.
+ */
+void sim_setReverberation(int8_t sensor, bool enable);
+
+/**
+ * Makes sensors 'a' and 'b' hear each other: the burst of one reaches the other 'travelTime' us
+ * after it went out. A SIM_ECHO echo that would come back later than that ends when the burst
+ * of the other sensor arrives. 0 makes them independent again, which is the default.
+ */
+void sim_setCrosstalk(int8_t a, int8_t b, uint32_t travelTime);
+
+/**
+ * Sets the CPU time (us) charged for every call to an interrupt handler, and the time the
+ * interrupts are masked, every 'period' us, for 'length' us, to mimic the WiFi stack. 0 disables.
+ */
+void sim_setIsrCost(uint32_t cost);
+void sim_setInterruptBlackout(uint32_t period, uint32_t length);
+
+/**
+ * Runs tasks, timers and interrupts for 'us' microseconds of virtual time.
+ */
+void sim_run(uint32_t us);
+
+/**
+ * Runs until 'done' returns true, or 'timeout' us have passed. Returns false on time out.
+ */
+bool sim_runUntil(bool (*done)(void *arg), void *arg, uint32_t timeout);
+
+/**
+ * The virtual time since sim_init() in us, it doesn't wrap.
+ */
+uint64_t sim_now(void);
+
+/**
+ * Copies the simulator statistics, optionally resetting them.
+ */
+void sim_getStats(Sim_Stats *stats, bool reset);
+
+/**
+ * Set to make os_printf() print, it is quiet by default.
+ */
+void sim_setVerbose(bool verbose);
+
+#endif /* HOST_SIM_H_ */
@@ -1,6 +1,12 @@
 #ifndef _USER_CONFIG_H_
 #define _USER_CONFIG_H_
 
-#define PING_SAMPLE_PERIOD 250 // 250 ms between each sample. you could go faster if you like
+#define PING_MIN_SAMPLE_PERIOD 50 // 50 ms between each sample while the readings change
+#define PING_MAX_SAMPLE_PERIOD 2000 // backing off to 2000 ms while they are stable
+#define PING_CHANGE_THRESHOLD 20 // 20 mm, smaller changes count as stable
+#define PING_CCOUNT_TIMESTAMPS // time stamp the echoes with the CPU cycle counter instead of system_get_time()
+//#define USE_TELEMETRY // send the samples as binary telemetry frames instead of text, see tools/telemetry_decode.c
+//#define STDOUT_BLOCK_WHEN_FULL // wait for the UART instead of dropping output when the stdout buffer is full
+//#define PING_LATENCY_STATS // record interrupt latency histograms, see ping_latencyDump()
 
 #endif
@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+#
+# ping_latency.py
+#
+# Pretty prints the interrupt latency histograms and the echo interrupt handler cost
+# written by ping_latencyDump() (compiled with PING_LATENCY_STATS). Reads a serial console log from a file or stdin:
+#
+#   python tools/ping_latency.py console.log
+#   miniterm.py /dev/ttyUSB0 115200 | python tools/ping_latency.py
+#
+import re
+import sys
+
+LINE = re.compile(r"ping_latency pin=(\d+) src=(\w+) tpu=(\d+)((?: \d+)+)")
+ISR_LINE = re.compile(r"ping_isr src=(\w+) mhz=(\d+) calls=(\d+) cycles=(\d+)")
+BAR_WIDTH = 40
+
+
+def format_ns(ns):
+    if ns >= 1000000:
+        return "%.1f ms" % (ns / 1000000.0)
+    if ns >= 1000:
+        return "%.1f us" % (ns / 1000.0)
+    return "%d ns" % ns
+
+
+def print_histogram(pin, src, ticks_per_us, buckets):
+    total = sum(buckets)
+    if not total:
+        return
+    print("GPIO%d %s handler, %d samples" % (pin, src, total))
+    biggest = max(buckets)
+    ns_per_tick = 1000.0 / ticks_per_us
+    below = 0
+    for i, count in enumerate(buckets):
+        if not count:
+            continue
+        low = 0 if i == 0 else format_ns(int((1 << i) * ns_per_tick))
+        if i == len(buckets) - 1:
+            label = ">= %s" % low
+        else:
+            label = "%s - %s" % (low, format_ns(int((1 << (i + 1)) * ns_per_tick)))
+        below += count
+        bar = "#" * max(1, count * BAR_WIDTH // biggest)
+        print("  %22s %8d %6.2f%% %s" % (label, count, 100.0 * below / total, bar))
+    print("")
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    latest = {}
+    isr = None
+    for line in source:
+        match = LINE.search(line)
+        if match:
+            key = (int(match.group(1)), match.group(2))
+            latest[key] = (int(match.group(3)), [int(c) for c in match.group(4).split()])
+        match = ISR_LINE.search(line)
+        if match:
+            isr = match.groups()
+    # the last dump of each pin wins
+    for (pin, src), (ticks_per_us, buckets) in sorted(latest.items()):
+        print_histogram(pin, src, ticks_per_us, buckets)
+    if isr:
+        src, mhz, calls, cycles = isr[0], int(isr[1]), int(isr[2]), int(isr[3])
+        per_call = cycles / float(calls)
+        print("%s handler: %d calls, %.1f cycles (%s) per call" % (src, calls, per_call,
+                                                                 format_ns(int(per_call * 1000 / mhz))))
+
+
+if __name__ == "__main__":
+    main()
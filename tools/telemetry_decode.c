@@ -0,0 +1,180 @@
+/*
+* telemetry_decode.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Host side decoder of the stream written by driver/telemetry, see telemetry.h for the format.
+ * Reads a captured stream from a file (or stdin) and writes CSV to stdout:
+ *
+ *   cc -o telemetry_decode tools/telemetry_decode.c
+ *   ./telemetry_decode capture.bin > samples.csv
+ *
+ * Anything that isn't a valid frame (console text, line noise) is skipped and counted on stderr.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#define MAX_FRAME 1024
+#define MAX_SENSORS 32
+
+static unsigned long goodFrames = 0;
+static unsigned long badFrames = 0;
+static unsigned long records = 0;
+
+static uint16_t
+crc16(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xffff;
+  int i = 0;
+  while (length--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (i=0; i<8; i++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/**
+ * Decodes a COBS frame (without the 0x00 delimiter) in place. Returns the decoded length, or -1.
+ */
+static long
+cobsDecode(uint8_t *data, size_t length) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < length) {
+    uint8_t code = data[i++];
+    uint8_t n = 0;
+    if (code == 0) {
+      return -1;
+    }
+    for (n=1; n<code; n++) {
+      if (i >= length) {
+        return -1;
+      }
+      data[o++] = data[i++];
+    }
+    if (code != 0xff && i < length) {
+      data[o++] = 0;
+    }
+  }
+  return (long)o;
+}
+
+static int
+getVarint(const uint8_t *data, size_t length, size_t *i, uint32_t *value) {
+  int shift = 0;
+  *value = 0;
+  while (*i < length && shift < 35) {
+    uint8_t b = data[(*i)++];
+    *value |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return 1;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+static void
+decodeFrame(uint8_t *frame, size_t length) {
+  uint32_t lastDistance[MAX_SENSORS] = {0};
+  uint32_t time = 0;
+  size_t i = 0;
+  long decoded = cobsDecode(frame, length);
+
+  if (decoded < 3 || crc16(frame, decoded - 2) != (frame[decoded-2] << 8 | frame[decoded-1])) {
+    badFrames++;
+    return;
+  }
+  length = decoded - 2;
+  // check the whole frame before printing any of it
+  for (i=0; i<length; ) {
+    uint8_t header = frame[i++];
+    uint32_t value = 0;
+    if (!getVarint(frame, length, &i, &value) || ((header & 7) == 0 && !getVarint(frame, length, &i, &value))) {
+      badFrames++;
+      return;
+    }
+  }
+  for (i=0; i<length; ) {
+    uint8_t header = frame[i++];
+    uint8_t sensor = header >> 3;
+    uint8_t status = header & 7;
+    uint32_t delta = 0;
+    uint32_t zigzag = 0;
+
+    // the first record of a frame has the absolute time
+    time = i == 1 ? 0 : time;
+    getVarint(frame, length, &i, &delta);
+    time += delta;
+    if (status == 0) {
+      getVarint(frame, length, &i, &zigzag);
+      lastDistance[sensor] += (zigzag >> 1) ^ -(zigzag & 1);
+      printf("%lu,%u,%u,%lu\n", (unsigned long)time, sensor, status, (unsigned long)lastDistance[sensor]);
+    } else {
+      printf("%lu,%u,%u,\n", (unsigned long)time, sensor, status);
+    }
+    records++;
+  }
+  goodFrames++;
+}
+
+int
+main(int argc, char **argv) {
+  FILE *in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  uint8_t frame[MAX_FRAME];
+  size_t length = 0;
+  int tooLong = 0;
+  int c = 0;
+
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+  printf("time_ms,sensor,status,distance\n");
+  while ((c = fgetc(in)) != EOF) {
+    if (c == 0) {
+      if (tooLong) {
+        badFrames++;
+      } else if (length) {
+        decodeFrame(frame, length);
+      }
+      length = 0;
+      tooLong = 0;
+    } else if (length < MAX_FRAME) {
+      frame[length++] = c;
+    } else {
+      // way too long to be a frame, skip it
+      tooLong = 1;
+    }
+  }
+  fprintf(stderr, "%lu frames, %lu records, %lu bad frames\n", goodFrames, records, badFrames);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+* rate_control.c
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "rate_control.h"
+#include "osapi.h"
+
+static void ICACHE_FLASH_ATTR
+rateControl_arm(RateControl *rc) {
+  os_timer_disarm(&rc->timer);
+  os_timer_arm(&rc->timer, rc->period, false);
+}
+
+/**
+ * Called by the ping driver when a ping has completed.
+ */
+static void ICACHE_FLASH_ATTR
+rateControl_pingCallback(Ping_Data *pingData, bool success, uint32_t echoTime, void *arg) {
+  RateControl *rc = (RateControl *) arg;
+  uint32_t distance = success ? ping_usToMm(pingData, echoTime) : 0;
+  bool changed = true;
+
+  if (!rc->isRunning) {
+    return;
+  }
+  if (rc->hasSample && success == rc->lastSuccess) {
+    changed = success &&
+        (distance > rc->lastDistance ? distance - rc->lastDistance : rc->lastDistance - distance) > rc->threshold;
+  }
+  if (changed) {
+    rc->period = rc->minPeriod;
+    rc->lastDistance = distance;
+    rc->lastSuccess = success;
+    rc->hasSample = true;
+  } else if (rc->period < rc->maxPeriod) {
+    rc->period <<= 1;
+    if (rc->period > rc->maxPeriod) {
+      rc->period = rc->maxPeriod;
+    }
+  }
+  if (rc->callback) {
+    rc->callback(rc, success, distance, changed);
+  }
+  rateControl_arm(rc);
+}
+
+static void ICACHE_FLASH_ATTR
+rateControl_timerCallback(void *arg) {
+  RateControl *rc = (RateControl *) arg;
+  if (!ping_startAsync(rc->pingData, ping_tenthMmToUs(rc->pingData, rc->maxDistance*10), rateControl_pingCallback, rc)) {
+    // the sensor is busy with something else, try again later
+    rateControl_arm(rc);
+  }
+}
+
+void ICACHE_FLASH_ATTR
+rateControl_start(RateControl *rc) {
+  rc->period = rc->minPeriod;
+  rc->hasSample = false;
+  rc->isRunning = true;
+  rateControl_arm(rc);
+}
+
+void ICACHE_FLASH_ATTR
+rateControl_stop(RateControl *rc) {
+  // a ping that is already running will see this and not re-arm the timer
+  rc->isRunning = false;
+  os_timer_disarm(&rc->timer);
+}
+
+void ICACHE_FLASH_ATTR
+rateControl_init(RateControl *rc, Ping_Data *pingData, const char *name, uint32_t maxDistance,
+    uint32_t minPeriod, uint32_t maxPeriod, uint32_t threshold, RateControl_Callback callback) {
+  rc->pingData = pingData;
+  rc->name = name;
+  rc->maxDistance = maxDistance;
+  rc->minPeriod = minPeriod;
+  rc->maxPeriod = maxPeriod < minPeriod ? minPeriod : maxPeriod;
+  rc->threshold = threshold;
+  rc->period = minPeriod;
+  rc->hasSample = false;
+  rc->isRunning = false;
+  rc->callback = callback;
+  os_timer_disarm(&rc->timer);
+  os_timer_setfn(&rc->timer, (os_timer_func_t *) rateControl_timerCallback, rc);
+}
@@ -0,0 +1,81 @@
+/*
+* rate_control.h
+*
+* Copyright (c) 2015, eadf (https://github.com/eadf)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of Redis nor the names of its contributors may be used
+* to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef USER_RATE_CONTROL_H_
+#define USER_RATE_CONTROL_H_
+
+#include "ping/ping.h"
+#include "os_type.h"
+
+typedef struct RateControl RateControl;
+
+/**
+ * Called with every sample. 'changed' is true if the distance moved more than the threshold.
+ */
+typedef void (*RateControl_Callback)(RateControl *rc, bool success, uint32_t distance, bool changed);
+
+/**
+ * Samples one sensor as often as needed: at minPeriod while the readings change, backing
+ * off exponentially to maxPeriod while they are stable.
+ */
+struct RateControl {
+  Ping_Data *pingData;
+  const char *name;
+  uint32_t maxDistance; // mm
+  uint32_t minPeriod;   // ms
+  uint32_t maxPeriod;   // ms
+  uint32_t threshold;   // mm, smallest change that counts as a change
+  uint32_t period;      // ms, the current sample period
+  uint32_t lastDistance;
+  bool lastSuccess;
+  bool hasSample;
+  bool isRunning;
+  RateControl_Callback callback;
+  os_timer_t timer;
+};
+
+/**
+ * Initiates the rate controller of an initiated sensor.
+ */
+void rateControl_init(RateControl *rc, Ping_Data *pingData, const char *name, uint32_t maxDistance,
+    uint32_t minPeriod, uint32_t maxPeriod, uint32_t threshold, RateControl_Callback callback);
+
+/**
+ * Starts sampling, at minPeriod.
+ */
+void rateControl_start(RateControl *rc);
+
+/**
+ * Stops sampling.
+ */
+void rateControl_stop(RateControl *rc);
+
+#endif /* USER_RATE_CONTROL_H_ */
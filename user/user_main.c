@@ -6,33 +6,46 @@
 #include "user_config.h"
 #include "user_interface.h"
 #include "stdout/stdout.h"
+#include "rate_control.h"
+#include "telemetry/telemetry.h"
 
 static volatile os_timer_t loop_timer;
 
 // forward declarations
 void user_init(void);
-void loop(void);
 static void setup(void);
 static Ping_Data pingA;
 static Ping_Data pingB;
+static RateControl rateA;
+static RateControl rateB;
+#ifdef USE_TELEMETRY
+static Telemetry telemetry;
+#endif
+
+#define MAX_DISTANCE 3000 // 3 meter
 
 /**
- * This is the main user program loop
+ * Called by the rate controller with every sample.
  */
-void ICACHE_FLASH_ATTR
-loop(void) {
-  float distance = 0;
-  float maxDistance = 3000; // 3 meter
-  if (ping_ping(&pingA, maxDistance, &distance) ) {
-    os_printf("A Response ~ %d mm \n", (int)distance);
-  } else {
-    os_printf("Failed to get any response from sensor A. Is maxDistance set too low?\n");
+static void ICACHE_FLASH_ATTR
+sampleCallback(RateControl *rc, bool success, uint32_t distance, bool changed) {
+#ifdef USE_TELEMETRY
+  telemetry_add(&telemetry, rc == &rateA ? 0 : 1, system_get_time()/1000, distance, ping_getStatus(rc->pingData));
+  if (changed) {
+    // don't sit on news
+    telemetry_flush(&telemetry);
+  }
+#else
+  if (!changed) {
+    // nothing new to report
+    return;
   }
-  if (ping_ping(&pingB, maxDistance, &distance) ) {
-    os_printf("B Response ~ %d mm \n", (int)distance);
+  if (success) {
+    os_printf("%s Response ~ %d mm (next sample in %d ms)\n", rc->name, (int)distance, (int)rc->period);
   } else {
-    os_printf("Failed to get any response from sensor B. Is maxDistance set too low?\n");
+    os_printf("Failed to get any response from sensor %s. Is maxDistance set too low?\n", rc->name);
   }
+#endif
 }
 
 /**
@@ -41,13 +54,19 @@ loop(void) {
  */
 static void ICACHE_FLASH_ATTR
 setup(void) {
+#ifdef USE_TELEMETRY
+  telemetry_init(&telemetry, stdout_write);
+#endif
   ping_init(&pingA, 2, 0, PING_MM); // trigger=GPIO2, echo=GPIO0, set the pins to the same value for one-pin-mode
   ping_init(&pingB, 4, 5, PING_MM); // trigger=GPIO4, echo=GPIO5, set the pins to the same value for one-pin-mode
+  rateControl_init(&rateA, &pingA, "A", MAX_DISTANCE, PING_MIN_SAMPLE_PERIOD, PING_MAX_SAMPLE_PERIOD,
+      PING_CHANGE_THRESHOLD, sampleCallback);
+  rateControl_init(&rateB, &pingB, "B", MAX_DISTANCE, PING_MIN_SAMPLE_PERIOD, PING_MAX_SAMPLE_PERIOD,
+      PING_CHANGE_THRESHOLD, sampleCallback);
 
-  // Start repeating loop timer
-  os_timer_disarm(&loop_timer);
-  os_timer_setfn(&loop_timer, (os_timer_func_t *) loop, NULL);
-  os_timer_arm(&loop_timer, PING_SAMPLE_PERIOD, true);
+  // The sensors are pointing in different directions, so they can be sampled independently
+  rateControl_start(&rateA);
+  rateControl_start(&rateB);
 }
 
 //Init function 